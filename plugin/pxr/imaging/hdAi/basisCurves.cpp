@@ -0,0 +1,504 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/basisCurves.h"
+
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec4f.h>
+
+#include <pxr/imaging/hdAi/instancer.h>
+#include <pxr/imaging/hdAi/material.h>
+#include <pxr/imaging/hdAi/utils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+namespace Str {
+const AtString name("name");
+const AtString curves("curves");
+const AtString visibility("visibility");
+const AtString points("points");
+const AtString num_points("num_points");
+const AtString radius("radius");
+const AtString basis("basis");
+const AtString linear("linear");
+const AtString bezier("bezier");
+const AtString b_spline("b-spline");
+const AtString catmull_rom("catmull-rom");
+const AtString shader("shader");
+const AtString matrix("matrix");
+} // namespace Str
+
+// Primvar read on the sync thread, and written to the curves when the staged
+// writes are committed.
+struct _Primvar {
+    TfToken name;
+    TfToken role;
+    HdInterpolation interpolation;
+    VtValue value;
+};
+
+// Arnold expects a radius for each segment end point of a curve, which for
+// the cubic bases is less than the number of control points.
+inline size_t _GetNumSegmentPoints(const AtString& basis, int numPoints) {
+    if (basis == Str::linear) { return static_cast<size_t>(numPoints); }
+    if (numPoints < 4) { return 0; }
+    if (basis == Str::bezier) {
+        return static_cast<size_t>((numPoints - 1) / 3 + 1);
+    }
+    // b-spline and catmull-rom curves don't reach their end points.
+    return static_cast<size_t>(numPoints - 2);
+}
+
+// The control point at the first segment end point of a curve, and the number
+// of control points between two segment end points.
+inline size_t _GetSegmentOffset(const AtString& basis) {
+    return basis == Str::b_spline || basis == Str::catmull_rom ? 1 : 0;
+}
+
+inline size_t _GetSegmentStep(const AtString& basis) {
+    return basis == Str::bezier ? 3 : 1;
+}
+
+template <typename T>
+inline T _Zero() {
+    T zero;
+    std::memset(&zero, 0, sizeof(T));
+    return zero;
+}
+
+// Arnold has no indexed curves, so the values of the control points are
+// gathered. Out of range indices get zeroes.
+template <typename T>
+void _Gather(
+    const T* src, size_t numElements, const VtIntArray& indices, T* dst) {
+    const auto zero = _Zero<T>();
+    const auto numIndices = indices.size();
+    for (auto i = decltype(numIndices){0}; i < numIndices; ++i) {
+        const auto index = static_cast<size_t>(indices[i]);
+        dst[i] = index < numElements ? src[index] : zero;
+    }
+}
+
+// Gathers the control points for each key.
+AtArray* _GatherPoints(AtArray* points, const VtIntArray& indices) {
+    const auto numElements = AiArrayGetNumElements(points);
+    const auto numKeys = AiArrayGetNumKeys(points);
+    const auto numIndices = static_cast<uint32_t>(indices.size());
+    auto* gathered = AiArrayAllocate(numIndices, numKeys, AI_TYPE_VECTOR);
+    if (numIndices > 0) {
+        const auto* src = static_cast<const AtVector*>(AiArrayMap(points));
+        auto* dst = static_cast<AtVector*>(AiArrayMap(gathered));
+        for (auto key = decltype(numKeys){0}; key < numKeys; ++key) {
+            _Gather(
+                src + key * numElements, numElements, indices,
+                dst + key * numIndices);
+        }
+        AiArrayUnmap(gathered);
+        AiArrayUnmap(points);
+    }
+    AiArrayDestroy(points);
+    return gathered;
+}
+
+// Gathers the values of a vertex primvar, like the control points.
+template <typename T>
+bool _GatherPrimvar(const VtIntArray& indices, VtValue& value) {
+    if (!value.IsHolding<VtArray<T>>()) { return false; }
+    VtArray<T> gathered(indices.size());
+    const auto& src = value.UncheckedGet<VtArray<T>>();
+    _Gather(src.cdata(), src.size(), indices, gathered.data());
+    value = VtValue(gathered);
+    return true;
+}
+
+// Values that can't be interpolated take the closest segment end point.
+template <typename T>
+inline T _Interpolate(const T& a, const T& b, float t, std::true_type) {
+    return t < 0.5f ? a : b;
+}
+
+template <typename T>
+inline T _Interpolate(const T& a, const T& b, float t, std::false_type) {
+    return a + (b - a) * t;
+}
+
+// Hydra's varying values are stored at the segment end points, while Arnold
+// stores the varying user data of curves at the control points. The control
+// points between two segment end points are interpolated.
+template <typename T>
+bool _RemapVaryingPrimvar(
+    const VtIntArray& curveVertexCounts, const AtString& basis,
+    VtValue& value) {
+    if (!value.IsHolding<VtArray<T>>()) { return false; }
+    const auto& src = value.UncheckedGet<VtArray<T>>();
+    size_t numVertices = 0;
+    size_t numSegmentPoints = 0;
+    for (const auto numPoints : curveVertexCounts) {
+        numVertices += static_cast<size_t>(std::max(0, numPoints));
+        numSegmentPoints += _GetNumSegmentPoints(basis, numPoints);
+    }
+    // Already a value for each control point, like for linear curves.
+    if (src.size() == numVertices) { return true; }
+    if (src.size() != numSegmentPoints) { return false; }
+    const auto offset = static_cast<float>(_GetSegmentOffset(basis));
+    const auto step = static_cast<float>(_GetSegmentStep(basis));
+    VtArray<T> remapped(numVertices);
+    size_t vertex = 0;
+    size_t segmentPoint = 0;
+    for (const auto numPoints : curveVertexCounts) {
+        const auto n = _GetNumSegmentPoints(basis, numPoints);
+        for (auto i = 0; i < numPoints; ++i) {
+            if (n == 0) {
+                remapped[vertex++] = _Zero<T>();
+                continue;
+            }
+            const auto position = std::min(
+                static_cast<float>(n - 1),
+                std::max(0.0f, (static_cast<float>(i) - offset) / step));
+            const auto first = static_cast<size_t>(std::floor(position));
+            const auto second = std::min(first + 1, n - 1);
+            remapped[vertex++] = _Interpolate(
+                src[segmentPoint + first], src[segmentPoint + second],
+                position - static_cast<float>(first),
+                std::is_integral<T>());
+        }
+        segmentPoint += n;
+    }
+    value = VtValue(remapped);
+    return true;
+}
+
+// Returns false if the type of \p value is not supported, or the number of
+// values doesn't match the segment end points.
+bool _RemapVaryingPrimvar(
+    const VtIntArray& curveVertexCounts, const AtString& basis,
+    VtValue& value) {
+    return _RemapVaryingPrimvar<bool>(curveVertexCounts, basis, value) ||
+           _RemapVaryingPrimvar<unsigned char>(
+               curveVertexCounts, basis, value) ||
+           _RemapVaryingPrimvar<unsigned int>(
+               curveVertexCounts, basis, value) ||
+           _RemapVaryingPrimvar<int>(curveVertexCounts, basis, value) ||
+           _RemapVaryingPrimvar<float>(curveVertexCounts, basis, value) ||
+           _RemapVaryingPrimvar<GfVec2f>(curveVertexCounts, basis, value) ||
+           _RemapVaryingPrimvar<GfVec3f>(curveVertexCounts, basis, value) ||
+           _RemapVaryingPrimvar<GfVec4f>(curveVertexCounts, basis, value);
+}
+
+// Returns false if the type of \p value is not supported.
+bool _GatherVertexPrimvar(const VtIntArray& indices, VtValue& value) {
+    return _GatherPrimvar<bool>(indices, value) ||
+           _GatherPrimvar<unsigned char>(indices, value) ||
+           _GatherPrimvar<unsigned int>(indices, value) ||
+           _GatherPrimvar<int>(indices, value) ||
+           _GatherPrimvar<float>(indices, value) ||
+           _GatherPrimvar<GfVec2f>(indices, value) ||
+           _GatherPrimvar<GfVec3f>(indices, value) ||
+           _GatherPrimvar<GfVec4f>(indices, value);
+}
+
+// Converts the widths to the radius of the curves. Returns nullptr if the
+// widths don't match the topology.
+AtArray* _ConvertWidths(
+    const VtValue& value, HdInterpolation interpolation,
+    const VtIntArray& curveVertexCounts, const VtIntArray& curveIndices,
+    const AtString& basis) {
+    if (!value.IsHolding<VtFloatArray>()) { return nullptr; }
+    const auto& widths = value.UncheckedGet<VtFloatArray>();
+    if (widths.empty()) { return nullptr; }
+    std::vector<float> radius;
+    if (interpolation == HdInterpolationConstant) {
+        radius.push_back(widths[0] * 0.5f);
+    } else if (interpolation == HdInterpolationVarying) {
+        radius.resize(widths.size());
+        std::transform(
+            widths.begin(), widths.end(), radius.begin(),
+            [](float width) -> float { return width * 0.5f; });
+    } else {
+        size_t numSegmentPoints = 0;
+        for (auto numPoints : curveVertexCounts) {
+            numSegmentPoints += _GetNumSegmentPoints(basis, numPoints);
+        }
+        radius.reserve(numSegmentPoints);
+        size_t vertex = 0;
+        for (auto curve = decltype(curveVertexCounts.size()){0};
+             curve < curveVertexCounts.size(); ++curve) {
+            const auto numPoints = curveVertexCounts[curve];
+            const auto n = _GetNumSegmentPoints(basis, numPoints);
+            if (interpolation == HdInterpolationUniform) {
+                if (curve >= widths.size()) { return nullptr; }
+                radius.insert(radius.end(), n, widths[curve] * 0.5f);
+            } else {
+                // Picks the control points at the segment end points.
+                const auto offset = _GetSegmentOffset(basis);
+                const auto step = _GetSegmentStep(basis);
+                for (auto i = decltype(n){0}; i < n; ++i) {
+                    auto index = vertex + offset + i * step;
+                    if (!curveIndices.empty()) {
+                        if (index >= curveIndices.size()) { return nullptr; }
+                        index = static_cast<size_t>(curveIndices[index]);
+                    }
+                    if (index >= widths.size()) { return nullptr; }
+                    radius.push_back(widths[index] * 0.5f);
+                }
+            }
+            vertex += static_cast<size_t>(std::max(0, numPoints));
+        }
+    }
+    return AiArrayConvert(
+        static_cast<uint32_t>(radius.size()), 1, AI_TYPE_FLOAT, radius.data());
+}
+
+} // namespace
+
+HdAiBasisCurves::HdAiBasisCurves(
+    HdAiRenderDelegate* delegate, const SdfPath& id, const SdfPath& instancerId)
+    : HdBasisCurves(id, instancerId), _delegate(delegate), _basis(Str::linear) {
+    _curves = AiNode(delegate->GetUniverse(), Str::curves);
+    AiNodeSetStr(_curves, Str::name, id.GetText());
+    _delegate->GetStats().NodeCreated();
+}
+
+HdAiBasisCurves::~HdAiBasisCurves() {
+    _delegate->GetMaterialBindings().Unbind(GetId());
+    _delegate->GetLightLinking().RemoveShape(_curves);
+    // The instancer might be already destroyed.
+    for (auto* instance : _instances) {
+        _delegate->GetLightLinking().RemoveShape(instance);
+        AiNodeDestroy(instance);
+    }
+    _delegate->GetStats().NodeDestroyed(_instances.size());
+    AiNodeDestroy(_curves);
+    _delegate->GetStats().NodeDestroyed();
+}
+
+void HdAiBasisCurves::Sync(
+    HdSceneDelegate* delegate, HdRenderParam* renderParam,
+    HdDirtyBits* dirtyBits, const TfToken& reprToken) {
+    auto* param = reinterpret_cast<HdAiRenderParam*>(renderParam);
+    HdAiRenderStats::SyncTimer timer(
+        param->GetStats(), HdPrimTypeTokens->basisCurves);
+    const auto& id = GetId();
+    // Curves are synced in parallel, like meshes, so the data is translated
+    // here and the writes to the Arnold nodes are staged.
+    auto* curves = _curves;
+
+    // The points and widths depend on the topology, so they are translated
+    // again when it changes.
+    auto topologyChanged = false;
+    if (HdChangeTracker::IsTopologyDirty(*dirtyBits, id)) {
+        const auto topology = GetBasisCurvesTopology(delegate);
+        _curveVertexCounts = topology.GetCurveVertexCounts();
+        _curveIndices = topology.GetCurveIndices();
+        const auto& basis = topology.GetCurveBasis();
+        // Periodic curves are translated as non-periodic ones, Arnold doesn't
+        // support them.
+        if (topology.GetCurveType() == HdTokens->linear) {
+            _basis = Str::linear;
+        } else if (basis == HdTokens->bSpline) {
+            _basis = Str::b_spline;
+        } else if (basis == HdTokens->catmullRom) {
+            _basis = Str::catmull_rom;
+        } else {
+            _basis = Str::bezier;
+        }
+        auto* numPoints = HdAiConvertIndices(_curveVertexCounts);
+        const auto arnoldBasis = _basis;
+        param->Stage([curves, numPoints, arnoldBasis]() {
+            AiNodeSetArray(curves, Str::num_points, numPoints);
+            AiNodeSetStr(curves, Str::basis, arnoldBasis);
+        });
+        topologyChanged = true;
+    }
+
+    if (topologyChanged ||
+        HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->points)) {
+        auto* points = HdAiSampleDeformationKeys(
+            delegate, id, HdTokens->points, _pointSamples);
+        if (points != nullptr) {
+            if (!_curveIndices.empty()) {
+                points = _GatherPoints(points, _curveIndices);
+            }
+            param->Stage([curves, points]() {
+                AiNodeSetArray(curves, Str::points, points);
+                HdAiSetMotionRange(curves);
+            });
+        }
+    }
+
+    if (topologyChanged ||
+        HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->widths)) {
+        AtArray* radius = nullptr;
+        for (const auto interpolation :
+             {HdInterpolationConstant, HdInterpolationUniform,
+              HdInterpolationVarying, HdInterpolationVertex}) {
+            for (const auto& primvar :
+                 delegate->GetPrimvarDescriptors(id, interpolation)) {
+                if (primvar.name != HdTokens->widths) { continue; }
+                if (radius != nullptr) { AiArrayDestroy(radius); }
+                radius = _ConvertWidths(
+                    delegate->Get(id, primvar.name), interpolation,
+                    _curveVertexCounts, _curveIndices, _basis);
+            }
+        }
+        param->Stage([curves, radius]() {
+            if (radius != nullptr) {
+                AiNodeSetArray(curves, Str::radius, radius);
+            } else {
+                AiNodeResetParameter(curves, Str::radius.c_str());
+            }
+        });
+    }
+
+    auto visibilityChanged = false;
+    if (HdChangeTracker::IsVisibilityDirty(*dirtyBits, id)) {
+        _UpdateVisibility(delegate, dirtyBits);
+        visibilityChanged = true;
+    }
+
+    const uint8_t visibility = _sharedData.visible ? AI_RAY_ALL : uint8_t(0);
+    const auto& instancerId = GetInstancerId();
+    if (instancerId.IsEmpty()) {
+        if (visibilityChanged) {
+            param->Stage([curves, visibility]() {
+                AiNodeSetByte(curves, Str::visibility, visibility);
+            });
+        }
+    } else if (
+        visibilityChanged ||
+        HdChangeTracker::IsInstancerDirty(*dirtyBits, id) ||
+        HdChangeTracker::IsInstanceIndexDirty(*dirtyBits, id)) {
+        auto* instancer = dynamic_cast<HdAiInstancer*>(
+            delegate->GetRenderIndex().GetInstancer(instancerId));
+        if (instancer != nullptr) {
+            param->Stage([this, instancer, visibility]() {
+                // Only the ginstance nodes are rendered, the curves are their
+                // source.
+                AiNodeSetByte(_curves, Str::visibility, 0);
+                instancer->SyncInstances(
+                    _curves, GetId(), visibility, _instances);
+            });
+        }
+    }
+
+    if (*dirtyBits & HdChangeTracker::DirtyCategories) {
+        const auto categories = delegate->GetCategories(id);
+        param->Stage([this, curves, categories]() {
+            auto& lightLinking = _delegate->GetLightLinking();
+            lightLinking.SetShape(curves, categories);
+            lightLinking.SetInstances(curves, _instances);
+        });
+    }
+
+    if (HdChangeTracker::IsTransformDirty(*dirtyBits, id)) {
+        auto* matrices = HdAiSampleTransform(delegate, id);
+        param->Stage([curves, matrices]() {
+            AiNodeSetArray(curves, Str::matrix, matrices);
+        });
+    }
+
+    if (*dirtyBits & HdChangeTracker::DirtyMaterialId) {
+        const auto materialId = delegate->GetMaterialId(id);
+        param->Stage([this, materialId]() {
+            _delegate->GetMaterialBindings().Bind(GetId(), materialId);
+        });
+        const auto* material = reinterpret_cast<const HdAiMaterial*>(
+            delegate->GetRenderIndex().GetSprim(
+                HdPrimTypeTokens->material, materialId));
+        auto* shader = material != nullptr ? material->GetSurfaceShader()
+                                           : _delegate->GetFallbackShader();
+        param->Stage([curves, shader]() {
+            AiNodeSetPtr(curves, Str::shader, shader);
+        });
+    }
+
+    if (topologyChanged || (*dirtyBits & HdChangeTracker::DirtyPrimvar)) {
+        std::vector<_Primvar> primvars;
+        for (const auto interpolation :
+             {HdInterpolationConstant, HdInterpolationUniform,
+              HdInterpolationVarying, HdInterpolationVertex}) {
+            for (const auto& primvar :
+                 delegate->GetPrimvarDescriptors(id, interpolation)) {
+                if (primvar.name == HdTokens->points ||
+                    primvar.name == HdTokens->widths) {
+                    continue;
+                }
+                auto value = delegate->Get(id, primvar.name);
+                // Both end up with a value for each control point, values
+                // that can't be converted would not match them.
+                if (interpolation == HdInterpolationVertex) {
+                    if (!_curveIndices.empty() &&
+                        !_GatherVertexPrimvar(_curveIndices, value)) {
+                        continue;
+                    }
+                } else if (
+                    interpolation == HdInterpolationVarying &&
+                    !_RemapVaryingPrimvar(
+                        _curveVertexCounts, _basis, value)) {
+                    continue;
+                }
+                primvars.push_back(
+                    {primvar.name, primvar.role, interpolation,
+                     std::move(value)});
+            }
+        }
+        param->Stage([curves, primvars]() {
+            for (const auto& primvar : primvars) {
+                if (primvar.interpolation == HdInterpolationConstant) {
+                    HdAiSetConstantPrimvar(
+                        curves, primvar.name, primvar.role, primvar.value);
+                } else if (primvar.interpolation == HdInterpolationUniform) {
+                    HdAiSetUniformPrimvar(
+                        curves, primvar.name, primvar.role, primvar.value);
+                } else {
+                    // Varying user data of curves has a value for each
+                    // control point.
+                    HdAiSetVertexPrimvar(
+                        curves, primvar.name, primvar.role, primvar.value);
+                }
+            }
+        });
+    }
+
+    *dirtyBits = HdChangeTracker::Clean;
+}
+
+HdDirtyBits HdAiBasisCurves::GetInitialDirtyBitsMask() const {
+    return HdChangeTracker::Clean | HdChangeTracker::InitRepr |
+           HdChangeTracker::DirtyPoints | HdChangeTracker::DirtyTopology |
+           HdChangeTracker::DirtyTransform | HdChangeTracker::DirtyMaterialId |
+           HdChangeTracker::DirtyPrimvar | HdChangeTracker::DirtyVisibility |
+           HdChangeTracker::DirtyWidths | HdChangeTracker::DirtyInstancer |
+           HdChangeTracker::DirtyInstanceIndex |
+           HdChangeTracker::DirtyCategories;
+}
+
+HdDirtyBits HdAiBasisCurves::_PropagateDirtyBits(HdDirtyBits bits) const {
+    return bits & HdChangeTracker::AllDirty;
+}
+
+void HdAiBasisCurves::_InitRepr(
+    const TfToken& reprToken, HdDirtyBits* dirtyBits) {
+    TF_UNUSED(reprToken);
+    TF_UNUSED(dirtyBits);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -36,12 +36,53 @@ TF_DEFINE_ENV_SETTING(
 TF_DEFINE_ENV_SETTING(
     HDAI_enable_progressive_render, true, "Enable progressive render.");
 
+TF_DEFINE_ENV_SETTING(
+    HDAI_progressive_min_AA_samples, -3,
+    "Lowest AA samples of the progressive passes.");
+
+TF_DEFINE_ENV_SETTING(
+    HDAI_interactive_target_fps, 30,
+    "Target frame rate when picking the progressive passes.");
+
 // This macro doesn't support floating point values.
 TF_DEFINE_ENV_SETTING(
     HDAI_shutter_start, "-0.25f", "Shutter start for the camera.");
 
 TF_DEFINE_ENV_SETTING(HDAI_shutter_end, "0.25f", "Shutter end for the camera.");
 
+TF_DEFINE_ENV_SETTING(
+    HDAI_deformation_motion_keys, 2,
+    "Number of motion keys for deforming shapes.");
+
+TF_DEFINE_ENV_SETTING(
+    HDAI_velocity_motion_blur, true,
+    "Use velocities and accelerations for the motion keys when authored.");
+
+TF_DEFINE_ENV_SETTING(
+    HDAI_frames_per_second, "24.0f",
+    "Frame rate used to convert velocities to per frame units.");
+
+TF_DEFINE_ENV_SETTING(
+    HDAI_weld_face_varying, false,
+    "Weld identical face-varying values on their first sync, to store them "
+    "indexed.");
+
+TF_DEFINE_ENV_SETTING(
+    HDAI_deduplicate_meshes, true,
+    "Share the geometry of static meshes with identical content.");
+
+TF_DEFINE_ENV_SETTING(
+    HDAI_deduplicate_shaders, true,
+    "Share identical shader subgraphs between materials.");
+
+TF_DEFINE_ENV_SETTING(
+    HDAI_texture_cache, true,
+    "Convert textures to tiled, mipmapped tx files in the background.");
+
+TF_DEFINE_ENV_SETTING(
+    HDAI_texture_cache_path, "",
+    "Directory of the converted textures, defaults to the temp directory.");
+
 HdAiConfig::HdAiConfig() {
     bucket_size = std::max(1, TfGetEnvSetting(HDAI_bucket_size));
     abort_on_error = TfGetEnvSetting(HDAI_abort_on_error);
@@ -49,10 +90,26 @@ HdAiConfig::HdAiConfig() {
     GI_diffuse_depth = std::max(0, TfGetEnvSetting(HDAI_GI_diffuse_depth));
     GI_specular_depth = std::max(0, TfGetEnvSetting(HDAI_GI_specular_depth));
     enable_progressive_render = TfGetEnvSetting(HDAI_enable_progressive_render);
+    progressive_min_AA_samples =
+        TfGetEnvSetting(HDAI_progressive_min_AA_samples);
+    interactive_target_fps =
+        std::max(1, TfGetEnvSetting(HDAI_interactive_target_fps));
     shutter_start = static_cast<float>(
         std::atof(TfGetEnvSetting(HDAI_shutter_start).c_str()));
     shutter_end = static_cast<float>(
         std::atof(TfGetEnvSetting(HDAI_shutter_end).c_str()));
+    // Arnold stores the number of motion keys in a byte.
+    deformation_motion_keys = std::min(
+        255, std::max(1, TfGetEnvSetting(HDAI_deformation_motion_keys)));
+    velocity_motion_blur = TfGetEnvSetting(HDAI_velocity_motion_blur);
+    frames_per_second = std::max(
+        1.0f, static_cast<float>(std::atof(
+                  TfGetEnvSetting(HDAI_frames_per_second).c_str())));
+    weld_face_varying = TfGetEnvSetting(HDAI_weld_face_varying);
+    deduplicate_meshes = TfGetEnvSetting(HDAI_deduplicate_meshes);
+    deduplicate_shaders = TfGetEnvSetting(HDAI_deduplicate_shaders);
+    texture_cache = TfGetEnvSetting(HDAI_texture_cache);
+    texture_cache_path = TfGetEnvSetting(HDAI_texture_cache_path);
 }
 
 const HdAiConfig& HdAiConfig::GetInstance() {
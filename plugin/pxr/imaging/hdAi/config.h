@@ -20,6 +20,8 @@
 
 #include "pxr/imaging/hdAi/api.h"
 
+#include <string>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 class HdAiConfig {
@@ -45,12 +47,42 @@ public:
     /// HDAI_enable_progressive_render
     bool enable_progressive_render;
 
+    /// HDAI_progressive_min_AA_samples
+    int progressive_min_AA_samples;
+
+    /// HDAI_interactive_target_fps
+    int interactive_target_fps;
+
     /// HDAI_shutter_start
     float shutter_start;
 
     /// HDAI_shutter_end
     float shutter_end;
 
+    /// HDAI_deformation_motion_keys
+    int deformation_motion_keys;
+
+    /// HDAI_velocity_motion_blur
+    bool velocity_motion_blur;
+
+    /// HDAI_frames_per_second
+    float frames_per_second;
+
+    /// HDAI_weld_face_varying
+    bool weld_face_varying;
+
+    /// HDAI_deduplicate_meshes
+    bool deduplicate_meshes;
+
+    /// HDAI_deduplicate_shaders
+    bool deduplicate_shaders;
+
+    /// HDAI_texture_cache
+    bool texture_cache;
+
+    /// HDAI_texture_cache_path
+    std::string texture_cache_path;
+
 private:
     HDAI_API
     HdAiConfig();
@@ -23,6 +23,10 @@ TF_REGISTRY_FUNCTION(TfDebug) {
         HDAI_MATERIAL,
         "Print info about material translation for the arnold hydra render "
         "delegate");
+    TF_DEBUG_ENVIRONMENT_SYMBOL(
+        HDAI_BUCKET_ARENA,
+        "Print allocation statistics of the bucket arena used by the arnold "
+        "hydra render delegate");
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -22,7 +22,8 @@ PXR_NAMESPACE_OPEN_SCOPE
 
 // clang-format off
 TF_DEBUG_CODES(
-    HDAI_MATERIAL
+    HDAI_MATERIAL,
+    HDAI_BUCKET_ARENA
 );
 // clang-format on
 
@@ -0,0 +1,207 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/geometryRegistry.h"
+
+#include <pxr/base/tf/staticTokens.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include "pxr/imaging/hdAi/mesh.h"
+
+#include <algorithm>
+#include <cstring>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_PRIVATE_TOKENS(
+    _tokens, (dedupMeshes)(dedupGeometries)(dedupRatio)(dedupBytesSaved));
+
+namespace {
+namespace Str {
+const AtString visibility("visibility");
+const AtString matrix("matrix");
+const AtString shader("shader");
+const AtString disp_map("disp_map");
+const AtString subdiv_type("subdiv_type");
+const AtString subdiv_iterations("subdiv_iterations");
+} // namespace Str
+
+// The parameters holding the bulk of the memory of a polymesh.
+const AtString _sharedArrays[] = {
+    AtString("vlist"),       AtString("vidxs"),      AtString("nsides"),
+    AtString("uvlist"),      AtString("uvidxs"),     AtString("crease_idxs"),
+    AtString("crease_sharpness"), AtString("nlist"),  AtString("nidxs")};
+
+size_t _GetArrayBytes(const AtArray* arr) {
+    return static_cast<size_t>(AiArrayGetNumElements(arr)) *
+           AiArrayGetNumKeys(arr) * AiParamGetTypeSize(AiArrayGetType(arr));
+}
+
+bool _IsSameArray(AtArray* a, AtArray* b) {
+    if (a == nullptr || b == nullptr) { return a == b; }
+    if (AiArrayGetType(a) != AiArrayGetType(b) ||
+        AiArrayGetNumElements(a) != AiArrayGetNumElements(b) ||
+        AiArrayGetNumKeys(a) != AiArrayGetNumKeys(b)) {
+        return false;
+    }
+    const auto bytes = _GetArrayBytes(a);
+    if (bytes == 0) { return true; }
+    const auto same = std::memcmp(AiArrayMap(a), AiArrayMap(b), bytes) == 0;
+    AiArrayUnmap(a);
+    AiArrayUnmap(b);
+    return same;
+}
+
+// The groups are keyed by a 64 bit hash of the translated content, so the
+// geometry is compared before it's shared, in case two hashes collide.
+bool _IsSameGeometry(AtNode* a, AtNode* b) {
+    if (AiNodeGetPtr(a, Str::shader) != AiNodeGetPtr(b, Str::shader) ||
+        AiNodeGetPtr(a, Str::disp_map) != AiNodeGetPtr(b, Str::disp_map) ||
+        AiNodeGetStr(a, Str::subdiv_type) !=
+            AiNodeGetStr(b, Str::subdiv_type) ||
+        AiNodeGetByte(a, Str::subdiv_iterations) !=
+            AiNodeGetByte(b, Str::subdiv_iterations)) {
+        return false;
+    }
+    for (const auto& param : _sharedArrays) {
+        if (!_IsSameArray(AiNodeGetArray(a, param), AiNodeGetArray(b, param))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+HdAiGeometryRegistry::HdAiGeometryRegistry(
+    AtUniverse* universe, HdAiRenderStats& stats)
+    : _universe(universe), _stats(stats) {}
+
+HdAiGeometryRegistry::~HdAiGeometryRegistry() {
+    for (auto& groups : _groups) {
+        for (auto& group : groups.second) {
+            if (group.shared != nullptr) {
+                AiNodeDestroy(group.shared);
+                _stats.NodeDestroyed();
+            }
+        }
+    }
+}
+
+void HdAiGeometryRegistry::Register(
+    HdAiMesh* mesh, AtNode* source, size_t hash) {
+    auto& groups = _groups[hash];
+    auto it = std::find_if(
+        groups.begin(), groups.end(), [&](const Group& group) -> bool {
+            return _IsSameGeometry(
+                source, group.shared != nullptr ? group.shared : group.source);
+        });
+    if (it == groups.end()) {
+        groups.emplace_back();
+        groups.back().meshes.push_back(mesh);
+        groups.back().source = source;
+        return;
+    }
+    auto& group = *it;
+    group.meshes.push_back(mesh);
+    if (group.shared == nullptr) {
+        group.shared = _CreateShared(group.source, group.bytes);
+        group.source = nullptr;
+        for (auto* member : group.meshes) {
+            member->UseSharedGeometry(group.shared);
+        }
+    } else {
+        mesh->UseSharedGeometry(group.shared);
+    }
+}
+
+void HdAiGeometryRegistry::Unregister(HdAiMesh* mesh, size_t hash) {
+    auto it = _groups.find(hash);
+    if (it == _groups.end()) { return; }
+    auto& groups = it->second;
+    auto groupIt = std::find_if(
+        groups.begin(), groups.end(), [&](const Group& group) -> bool {
+            return std::find(
+                       group.meshes.begin(), group.meshes.end(), mesh) !=
+                   group.meshes.end();
+        });
+    if (groupIt == groups.end()) { return; }
+    auto& meshes = groupIt->meshes;
+    meshes.erase(std::remove(meshes.begin(), meshes.end(), mesh), meshes.end());
+    // The last mesh of the group keeps using the shared geometry, since its
+    // own polymesh doesn't hold the geometry anymore.
+    if (meshes.empty()) {
+        if (groupIt->shared != nullptr) {
+            AiNodeDestroy(groupIt->shared);
+            _stats.NodeDestroyed();
+        }
+        groups.erase(groupIt);
+        if (groups.empty()) { _groups.erase(it); }
+    }
+}
+
+void HdAiGeometryRegistry::ReleaseGeometry(AtNode* node) {
+    for (const auto& param : _sharedArrays) {
+        AiNodeResetParameter(node, param);
+    }
+}
+
+VtDictionary HdAiGeometryRegistry::GetStats() const {
+    size_t numMeshes = 0;
+    size_t numGeometries = 0;
+    size_t bytesSaved = 0;
+    for (const auto& groups : _groups) {
+        for (const auto& group : groups.second) {
+            if (group.shared == nullptr) { continue; }
+            const auto numGroupMeshes = group.meshes.size();
+            numMeshes += numGroupMeshes;
+            numGeometries += 1;
+            // Every mesh would hold a copy of the geometry without sharing.
+            if (numGroupMeshes > 1) {
+                bytesSaved += (numGroupMeshes - 1) * group.bytes;
+            }
+        }
+    }
+    VtDictionary stats;
+    stats[_tokens->dedupMeshes.GetString()] =
+        VtValue(static_cast<int64_t>(numMeshes));
+    stats[_tokens->dedupGeometries.GetString()] =
+        VtValue(static_cast<int64_t>(numGeometries));
+    stats[_tokens->dedupRatio.GetString()] = VtValue(
+        numGeometries == 0 ? 1.0
+                           : static_cast<double>(numMeshes) /
+                                 static_cast<double>(numGeometries));
+    stats[_tokens->dedupBytesSaved.GetString()] =
+        VtValue(static_cast<int64_t>(bytesSaved));
+    return stats;
+}
+
+AtNode* HdAiGeometryRegistry::_CreateShared(AtNode* source, size_t& bytes) {
+    auto* shared = AiNodeClone(
+        source,
+        AtString(
+            TfStringPrintf("/__hdAiSharedGeometry_%zu", _numShared++).c_str()));
+    _stats.NodeCreated();
+    // Only rendered through the ginstance nodes of the meshes, which hold
+    // the transforms.
+    AiNodeSetByte(shared, Str::visibility, 0);
+    AiNodeSetMatrix(shared, Str::matrix, AiM4Identity());
+    bytes = 0;
+    for (const auto& param : _sharedArrays) {
+        const auto* arr = AiNodeGetArray(shared, param);
+        if (arr != nullptr) { bytes += _GetArrayBytes(arr); }
+    }
+    return shared;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,93 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_GEOMETRY_REGISTRY_H
+#define HDAI_GEOMETRY_REGISTRY_H
+
+#include <pxr/pxr.h>
+#include "pxr/imaging/hdAi/api.h"
+
+#include <pxr/base/vt/dictionary.h>
+
+#include "pxr/imaging/hdAi/renderStats.h"
+
+#include <ai.h>
+
+#include <unordered_map>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class HdAiMesh;
+
+/// Deduplicates meshes with identical geometry.
+///
+/// Meshes register the hash of their translated content. Once two meshes
+/// share a hash and their geometry matches, the registry clones the polymesh
+/// of the first one, and all the meshes of the group render through a
+/// ginstance of the clone instead of their own polymesh, which drops its
+/// arrays. Arnold doesn't allow sharing an AtArray between nodes, so whole
+/// shapes are shared.
+///
+/// The registry is only accessed while committing the staged writes, or while
+/// creating and destroying prims, so it's not thread-safe.
+class HdAiGeometryRegistry {
+public:
+    HDAI_API
+    HdAiGeometryRegistry(AtUniverse* universe, HdAiRenderStats& stats);
+    HDAI_API
+    ~HdAiGeometryRegistry();
+
+    /// Adds \p mesh to the group of \p hash holding the same geometry as
+    /// \p source, the polymesh of \p mesh. The geometry is compared, since
+    /// different geometries might share a hash.
+    HDAI_API
+    void Register(HdAiMesh* mesh, AtNode* source, size_t hash);
+
+    /// Removes \p mesh from the group of \p hash.
+    HDAI_API
+    void Unregister(HdAiMesh* mesh, size_t hash);
+
+    /// Resets the parameters of \p node holding the geometry shared by the
+    /// group.
+    HDAI_API
+    static void ReleaseGeometry(AtNode* node);
+
+    /// Returns the number of deduplicated meshes, unique geometries, their
+    /// ratio and the bytes saved by sharing the geometries.
+    HDAI_API
+    VtDictionary GetStats() const;
+
+private:
+    struct Group {
+        std::vector<HdAiMesh*> meshes;
+        /// Polymesh of the first mesh, holding the geometry of the group until
+        /// it's shared.
+        AtNode* source = nullptr;
+        AtNode* shared = nullptr;
+        size_t bytes = 0;
+    };
+
+    AtNode* _CreateShared(AtNode* source, size_t& bytes);
+
+    AtUniverse* _universe;
+    HdAiRenderStats& _stats;
+    /// Groups with the same hash, there is more than one only when the hashes
+    /// of different geometries collide.
+    std::unordered_map<size_t, std::vector<Group>> _groups;
+    size_t _numShared = 0;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_GEOMETRY_REGISTRY_H
@@ -0,0 +1,248 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/instancer.h"
+
+#include <pxr/base/gf/quaternion.h>
+#include <pxr/base/gf/rotation.h>
+
+#include <pxr/base/tf/stl.h>
+
+#include <pxr/imaging/hd/tokens.h>
+
+#include "pxr/imaging/hdAi/utils.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+namespace Str {
+const AtString ginstance("ginstance");
+const AtString name("name");
+const AtString node("node");
+const AtString matrix("matrix");
+const AtString visibility("visibility");
+const AtString inherit_xform("inherit_xform");
+} // namespace Str
+
+// Transform primvars are baked into the instance matrices, and not exported
+// as user data.
+bool _IsTransformPrimvar(const TfToken& name) {
+    return name == HdInstancerTokens->instanceTransform ||
+           name == HdInstancerTokens->translate ||
+           name == HdInstancerTokens->rotate ||
+           name == HdInstancerTokens->scale;
+}
+
+} // namespace
+
+HdAiInstancer::HdAiInstancer(
+    HdAiRenderDelegate* delegate, HdSceneDelegate* sceneDelegate,
+    const SdfPath& id, const SdfPath& parentInstancerId)
+    : HdInstancer(sceneDelegate, id, parentInstancerId), _delegate(delegate) {}
+
+void HdAiInstancer::_SyncPrimvars() {
+    auto& changeTracker =
+        GetDelegate()->GetRenderIndex().GetChangeTracker();
+    const auto& id = GetId();
+
+    // The instances are synced from the staged writes, which run on a single
+    // thread, so the first prototype pulls the primvars for all of them.
+    const auto dirtyBits = changeTracker.GetInstancerDirtyBits(id);
+    if (!HdChangeTracker::IsAnyPrimvarDirty(dirtyBits, id)) { return; }
+
+    for (const auto& primvar : GetDelegate()->GetPrimvarDescriptors(
+             id, HdInterpolationInstance)) {
+        if (!HdChangeTracker::IsPrimvarDirty(dirtyBits, id, primvar.name)) {
+            continue;
+        }
+        const auto value = GetDelegate()->Get(id, primvar.name);
+        if (value.IsEmpty()) { continue; }
+        auto it = _primvars.find(primvar.name);
+        if (it == _primvars.end()) {
+            _primvars.insert({primvar.name, Primvar(value, primvar.role)});
+        } else {
+            it->second.value = value;
+            it->second.role = primvar.role;
+        }
+    }
+    changeTracker.MarkInstancerClean(id);
+}
+
+VtMatrix4dArray HdAiInstancer::CalculateInstanceMatrices(
+    const SdfPath& prototypeId) {
+    _SyncPrimvars();
+
+    const auto& id = GetId();
+    const auto instanceIndices =
+        GetDelegate()->GetInstanceIndices(id, prototypeId);
+    const auto numInstances = instanceIndices.size();
+    VtMatrix4dArray transforms(
+        numInstances, GetDelegate()->GetInstancerTransform(id));
+    if (numInstances == 0) { return transforms; }
+
+    const auto* pv = TfMapLookupPtr(_primvars, HdInstancerTokens->translate);
+    if (pv != nullptr && pv->value.IsHolding<VtVec3fArray>()) {
+        const auto& translates = pv->value.UncheckedGet<VtVec3fArray>();
+        for (auto i = decltype(numInstances){0}; i < numInstances; ++i) {
+            const auto index = instanceIndices[i];
+            if (index < 0 || static_cast<size_t>(index) >= translates.size()) {
+                continue;
+            }
+            GfMatrix4d m(1.0);
+            m.SetTranslate(GfVec3d(translates[index]));
+            transforms[i] = m * transforms[i];
+        }
+    }
+
+    pv = TfMapLookupPtr(_primvars, HdInstancerTokens->rotate);
+    if (pv != nullptr && pv->value.IsHolding<VtVec4fArray>()) {
+        const auto& rotates = pv->value.UncheckedGet<VtVec4fArray>();
+        for (auto i = decltype(numInstances){0}; i < numInstances; ++i) {
+            const auto index = instanceIndices[i];
+            if (index < 0 || static_cast<size_t>(index) >= rotates.size()) {
+                continue;
+            }
+            // Rotations are stored as quaternions, with the real part first.
+            const auto& q = rotates[index];
+            GfMatrix4d m(1.0);
+            m.SetRotate(GfRotation(
+                GfQuaternion(q[0], GfVec3d(q[1], q[2], q[3]))));
+            transforms[i] = m * transforms[i];
+        }
+    }
+
+    pv = TfMapLookupPtr(_primvars, HdInstancerTokens->scale);
+    if (pv != nullptr && pv->value.IsHolding<VtVec3fArray>()) {
+        const auto& scales = pv->value.UncheckedGet<VtVec3fArray>();
+        for (auto i = decltype(numInstances){0}; i < numInstances; ++i) {
+            const auto index = instanceIndices[i];
+            if (index < 0 || static_cast<size_t>(index) >= scales.size()) {
+                continue;
+            }
+            GfMatrix4d m(1.0);
+            m.SetScale(GfVec3d(scales[index]));
+            transforms[i] = m * transforms[i];
+        }
+    }
+
+    pv = TfMapLookupPtr(_primvars, HdInstancerTokens->instanceTransform);
+    if (pv != nullptr && pv->value.IsHolding<VtMatrix4dArray>()) {
+        const auto& instanceTransforms =
+            pv->value.UncheckedGet<VtMatrix4dArray>();
+        for (auto i = decltype(numInstances){0}; i < numInstances; ++i) {
+            const auto index = instanceIndices[i];
+            if (index < 0 ||
+                static_cast<size_t>(index) >= instanceTransforms.size()) {
+                continue;
+            }
+            transforms[i] = instanceTransforms[index] * transforms[i];
+        }
+    }
+
+    const auto& parentId = GetParentId();
+    if (parentId.IsEmpty()) { return transforms; }
+    auto* parent = dynamic_cast<HdAiInstancer*>(
+        GetDelegate()->GetRenderIndex().GetInstancer(parentId));
+    if (ARCH_UNLIKELY(parent == nullptr)) { return transforms; }
+
+    // Every instance of the parent instancer gets a copy of all our
+    // instances.
+    const auto parentTransforms = parent->CalculateInstanceMatrices(id);
+    const auto numParentInstances = parentTransforms.size();
+    VtMatrix4dArray nestedTransforms(numParentInstances * numInstances);
+    for (auto j = decltype(numParentInstances){0}; j < numParentInstances;
+         ++j) {
+        for (auto i = decltype(numInstances){0}; i < numInstances; ++i) {
+            nestedTransforms[j * numInstances + i] =
+                transforms[i] * parentTransforms[j];
+        }
+    }
+    return nestedTransforms;
+}
+
+void HdAiInstancer::SyncInstances(
+    AtNode* prototype, const SdfPath& prototypeId, uint8_t visibility,
+    std::vector<AtNode*>& instances) {
+    const auto transforms = CalculateInstanceMatrices(prototypeId);
+    const auto numInstances = transforms.size();
+    const auto oldNumInstances = instances.size();
+    auto& stats = _delegate->GetStats();
+    auto& lightLinking = _delegate->GetLightLinking();
+    if (numInstances < oldNumInstances) {
+        for (auto i = numInstances; i < oldNumInstances; ++i) {
+            lightLinking.RemoveShape(instances[i]);
+            AiNodeDestroy(instances[i]);
+        }
+        stats.NodeDestroyed(oldNumInstances - numInstances);
+        instances.resize(numInstances);
+    } else if (numInstances > oldNumInstances) {
+        instances.resize(numInstances);
+        const auto& prototypeName = prototypeId.GetString();
+        for (auto i = oldNumInstances; i < numInstances; ++i) {
+            auto* instance = AiNode(_delegate->GetUniverse(), Str::ginstance);
+            AiNodeSetStr(
+                instance, Str::name,
+                TfStringPrintf("%s/instance_%zu", prototypeName.c_str(), i)
+                    .c_str());
+            AiNodeSetPtr(instance, Str::node, prototype);
+            // The instance matrix is applied on top of the prototype's
+            // matrix, so transform and deformation blur of the prototype
+            // are shared.
+            AiNodeSetBool(instance, Str::inherit_xform, true);
+            instances[i] = instance;
+        }
+        stats.NodeCreated(numInstances - oldNumInstances);
+    }
+
+    for (auto i = decltype(numInstances){0}; i < numInstances; ++i) {
+        auto* instance = instances[i];
+        AiNodeSetMatrix(
+            instance, Str::matrix, HdAiConvertMatrix(transforms[i]));
+        AiNodeSetByte(instance, Str::visibility, visibility);
+    }
+    _SetInstancePrimvars(prototypeId, instances, 1);
+    lightLinking.SetInstances(prototype, instances);
+}
+
+void HdAiInstancer::_SetInstancePrimvars(
+    const SdfPath& prototypeId, std::vector<AtNode*>& instances,
+    size_t stride) {
+    const auto& id = GetId();
+    const auto instanceIndices =
+        GetDelegate()->GetInstanceIndices(id, prototypeId);
+    const auto numIndices = instanceIndices.size();
+    if (numIndices == 0) { return; }
+    const auto numInstances = instances.size();
+    for (const auto& primvar : _primvars) {
+        if (_IsTransformPrimvar(primvar.first)) { continue; }
+        for (auto i = decltype(numInstances){0}; i < numInstances; ++i) {
+            // Instances are ordered by the parent instance first, so the
+            // index of this level repeats every stride instances.
+            const auto index = instanceIndices[(i / stride) % numIndices];
+            if (index < 0) { continue; }
+            HdAiSetInstancePrimvar(
+                instances[i], primvar.first, primvar.second.role,
+                primvar.second.value, static_cast<size_t>(index));
+        }
+    }
+
+    const auto& parentId = GetParentId();
+    if (parentId.IsEmpty()) { return; }
+    auto* parent = dynamic_cast<HdAiInstancer*>(
+        GetDelegate()->GetRenderIndex().GetInstancer(parentId));
+    if (parent != nullptr) {
+        parent->_SetInstancePrimvars(id, instances, stride * numIndices);
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
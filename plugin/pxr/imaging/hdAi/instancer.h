@@ -0,0 +1,79 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_INSTANCER_H
+#define HDAI_INSTANCER_H
+
+#include <pxr/pxr.h>
+#include "pxr/imaging/hdAi/api.h"
+
+#include <pxr/imaging/hd/instancer.h>
+#include <pxr/imaging/hd/sceneDelegate.h>
+
+#include <pxr/base/tf/hashmap.h>
+#include <pxr/base/vt/types.h>
+
+#include "pxr/imaging/hdAi/renderDelegate.h"
+
+#include <ai.h>
+
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Instancer mapping each instance of a prototype to a ginstance node that
+/// references the single Arnold shape of the prototype.
+class HdAiInstancer : public HdInstancer {
+public:
+    HDAI_API
+    HdAiInstancer(
+        HdAiRenderDelegate* delegate, HdSceneDelegate* sceneDelegate,
+        const SdfPath& id, const SdfPath& parentInstancerId = SdfPath());
+
+    ~HdAiInstancer() override = default;
+
+    /// Returns the transforms of all the instances of \p prototypeId,
+    /// including the instances of the parent instancers.
+    HDAI_API
+    VtMatrix4dArray CalculateInstanceMatrices(const SdfPath& prototypeId);
+
+    /// Creates or destroys the ginstance nodes in \p instances so there is
+    /// one for each instance of \p prototypeId, then sets their transforms,
+    /// visibility, per-instance primvars and the light linking of
+    /// \p prototype. Only called from the staged writes, so it's never called
+    /// concurrently.
+    HDAI_API
+    void SyncInstances(
+        AtNode* prototype, const SdfPath& prototypeId, uint8_t visibility,
+        std::vector<AtNode*>& instances);
+
+protected:
+    void _SyncPrimvars();
+    void _SetInstancePrimvars(
+        const SdfPath& prototypeId, std::vector<AtNode*>& instances,
+        size_t stride);
+
+    struct Primvar {
+        Primvar(const VtValue& _value, const TfToken& _role)
+            : value(_value), role(_role) {}
+        VtValue value;
+        TfToken role;
+    };
+
+    HdAiRenderDelegate* _delegate;
+    TfHashMap<TfToken, Primvar, TfToken::HashFunctor> _primvars;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_INSTANCER_H
@@ -16,6 +16,8 @@
 #include "pxr/imaging/hdAi/material.h"
 #include "pxr/imaging/hdAi/utils.h"
 
+#include <pxr/base/tf/stringUtils.h>
+
 #include <pxr/usd/usdLux/tokens.h>
 
 #include <pxr/usd/sdf/assetPath.h>
@@ -24,8 +26,20 @@
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+TF_DEFINE_PRIVATE_TOKENS(_tokens, (light)(lightLink)(shadowLink));
+
 namespace {
 
+TfToken getLink(
+    HdSceneDelegate* delegate, const SdfPath& id, const TfToken& name) {
+    const auto value = delegate->GetLightParamValue(id, name);
+    if (value.IsHolding<TfToken>()) { return value.UncheckedGet<TfToken>(); }
+    if (value.IsHolding<std::string>()) {
+        return TfToken(value.UncheckedGet<std::string>());
+    }
+    return TfToken();
+}
+
 const AtString pointLightType("point_light");
 const AtString spotLightType("spot_light");
 const AtString distantLightType("distant_light");
@@ -102,34 +116,38 @@ bool hasSpotLightParams(HdSceneDelegate* delegate, const SdfPath& id) {
 }
 
 void iterateParams(
-    AtNode* light, const AtNodeEntry* nentry, const SdfPath& id,
+    HdAiLight& aiLight, AtNode* light, const AtNodeEntry* nentry,
     HdSceneDelegate* delegate, const std::vector<ParamDesc>& params) {
+    VtValue value;
     for (const auto& param : params) {
         const auto* pentry =
             AiNodeEntryLookUpParameter(nentry, param.arnoldName);
         if (pentry == nullptr) { continue; }
-        HdAiSetParameter(
-            light, pentry, delegate->GetLightParamValue(id, param.hdName));
+        if (!aiLight.UpdateParam(delegate, param.hdName, value)) { continue; }
+        HdAiSetParameter(light, pentry, value);
     }
 }
 
 auto pointLightSync = [](HdAiLight& aiLight, AtNode* light,
                          const AtNodeEntry* nentry, const SdfPath& id,
                          HdSceneDelegate* delegate) {
-    iterateParams(light, nentry, id, delegate, pointParams);
+    iterateParams(aiLight, light, nentry, delegate, pointParams);
 };
 
 auto spotLightSync = [](HdAiLight& aiLight, AtNode* light,
                         const AtNodeEntry* nentry, const SdfPath& id,
                         HdSceneDelegate* delegate) {
-    iterateParams(light, nentry, id, delegate, spotParams);
-
-    float hdAngle =
-        delegate->GetLightParamValue(id, HdLightTokens->shapingConeAngle)
-            .GetWithDefault(180.0f);
-    float softness =
-        delegate->GetLightParamValue(id, HdLightTokens->shapingConeSoftness)
-            .GetWithDefault(0.0f);
+    iterateParams(aiLight, light, nentry, delegate, spotParams);
+
+    VtValue angleValue;
+    VtValue softnessValue;
+    const auto angleChanged = aiLight.UpdateParam(
+        delegate, HdLightTokens->shapingConeAngle, angleValue);
+    const auto softnessChanged = aiLight.UpdateParam(
+        delegate, HdLightTokens->shapingConeSoftness, softnessValue);
+    if (!angleChanged && !softnessChanged) { return; }
+    float hdAngle = angleValue.GetWithDefault(180.0f);
+    float softness = softnessValue.GetWithDefault(0.0f);
     float arnoldAngle = hdAngle * 2;
     float penumbra = arnoldAngle * softness;
     AiNodeSetFlt(light, coneAngleStr, arnoldAngle);
@@ -139,27 +157,30 @@ auto spotLightSync = [](HdAiLight& aiLight, AtNode* light,
 auto distantLightSync = [](HdAiLight& aiLight, AtNode* light,
                            const AtNodeEntry* nentry, const SdfPath& id,
                            HdSceneDelegate* delegate) {
-    iterateParams(light, nentry, id, delegate, distantParams);
+    iterateParams(aiLight, light, nentry, delegate, distantParams);
 };
 
 auto diskLightSync = [](HdAiLight& aiLight, AtNode* light,
                         const AtNodeEntry* nentry, const SdfPath& id,
                         HdSceneDelegate* delegate) {
-    iterateParams(light, nentry, id, delegate, diskParams);
+    iterateParams(aiLight, light, nentry, delegate, diskParams);
 };
 
 auto rectLightSync = [](HdAiLight& aiLight, AtNode* light,
                         const AtNodeEntry* nentry, const SdfPath& id,
                         HdSceneDelegate* delegate) {
+    VtValue widthValue;
+    VtValue heightValue;
+    const auto widthChanged =
+        aiLight.UpdateParam(delegate, HdLightTokens->width, widthValue);
+    const auto heightChanged =
+        aiLight.UpdateParam(delegate, HdLightTokens->height, heightValue);
+    if (!widthChanged && !heightChanged) { return; }
     float width = 1.0f;
     float height = 1.0f;
-    const auto& widthValue =
-        delegate->GetLightParamValue(id, HdLightTokens->width);
     if (widthValue.IsHolding<float>()) {
         width = widthValue.UncheckedGet<float>();
     }
-    const auto& heightValue =
-        delegate->GetLightParamValue(id, HdLightTokens->height);
     if (heightValue.IsHolding<float>()) {
         height = heightValue.UncheckedGet<float>();
     }
@@ -178,10 +199,12 @@ auto rectLightSync = [](HdAiLight& aiLight, AtNode* light,
 auto cylinderLightSync = [](HdAiLight& aiLight, AtNode* light,
                             const AtNodeEntry* nentry, const SdfPath& id,
                             HdSceneDelegate* delegate) {
-    iterateParams(light, nentry, id, delegate, cylinderParams);
+    iterateParams(aiLight, light, nentry, delegate, cylinderParams);
+    VtValue lengthValue;
+    if (!aiLight.UpdateParam(delegate, UsdLuxTokens->length, lengthValue)) {
+        return light;
+    }
     float length = 1.0f;
-    const auto& lengthValue =
-        delegate->GetLightParamValue(id, UsdLuxTokens->length);
     if (lengthValue.IsHolding<float>()) {
         length = lengthValue.UncheckedGet<float>();
     }
@@ -194,9 +217,10 @@ auto cylinderLightSync = [](HdAiLight& aiLight, AtNode* light,
 auto domeLightSync = [](HdAiLight& aiLight, AtNode* light,
                         const AtNodeEntry* nentry, const SdfPath& id,
                         HdSceneDelegate* delegate) {
-    const auto& formatValue =
-        delegate->GetLightParamValue(id, UsdLuxTokens->textureFormat);
-    if (formatValue.IsHolding<TfToken>()) {
+    VtValue formatValue;
+    if (aiLight.UpdateParam(
+            delegate, UsdLuxTokens->textureFormat, formatValue) &&
+        formatValue.IsHolding<TfToken>()) {
         const auto& textureFormat = formatValue.UncheckedGet<TfToken>();
         if (textureFormat == UsdLuxTokens->latlong) {
             AiNodeSetStr(light, formatStr, latlongStr);
@@ -213,22 +237,25 @@ auto domeLightSync = [](HdAiLight& aiLight, AtNode* light,
 void HdAiLight::SpotOrPointLightSync(
     AtNode* light, const AtNodeEntry* nentry, const SdfPath& id,
     HdSceneDelegate* sceneDelegate) {
-    if (hasSpotLightParams(sceneDelegate, id)) {
-        // It's currently a point_light, but it has spot_light parameters...
-        // we need to convert this from a point_light into a spot_light.
-        // We do this by:
+    const auto isSpot = hasSpotLightParams(sceneDelegate, id);
+    // The node is only replaced when the light gains or loses the spot_light
+    // parameters, not on every sync.
+    if (isSpot != AiNodeIs(light, spotLightType)) {
+        // The light type changed, so we need to convert the node. We do this
+        // by:
         //
-        // 1. Rename the point_light to a temporary name
-        // 2. Create a spot_light with the old_name
+        // 1. Rename the old light to a temporary name
+        // 2. Create the new light with the old_name
         // 3. Swap the nodes with AiNodeReplace
         // 4. Update the internal data
+        if (_renderParam != nullptr) { _renderParam->Interrupt(); }
 
         auto universe = _delegate->GetUniverse();
 
-        // 1. Rename the point_light to a temporary name
+        // 1. Rename the old light to a temporary name
         AtNode* oldLight = light;
         auto oldName = AiNodeGetName(light);
-        std::string tempNameBase(std::string(oldName) + "_old_point_light");
+        std::string tempNameBase(std::string(oldName) + "_old_light");
         std::string tempName(tempNameBase);
         for (int i = 0; AiNodeLookUpByName(universe, tempName.c_str()); ++i) {
             tempName.replace(
@@ -237,20 +264,33 @@ void HdAiLight::SpotOrPointLightSync(
         }
         AiNodeSetStr(oldLight, "name", tempName.c_str());
 
-        // 2. Create a spot_light with the old_name
-        light = AiNode(universe, spotLightType);
+        // 2. Create the new light with the old_name
+        light = AiNode(universe, isSpot ? spotLightType : pointLightType);
         AiNodeSetStr(light, "name", oldName);
+        const auto* matrices = AiNodeGetArray(oldLight, "matrix");
+        if (matrices != nullptr) {
+            AiNodeSetArray(light, "matrix", AiArrayCopy(matrices));
+        }
 
         // 3. Swap the nodes with AiNodeReplace
         AiNodeReplace(oldLight, light, true);
+        _delegate->GetStats().NodeCreated();
+        _delegate->GetStats().NodeDestroyed();
 
-        // 4. Update the internal data
+        // 4. Update the internal data. The new node only has default values,
+        // so every parameter is written again, and the links are registered
+        // for the new node by Sync.
+        _delegate->GetLightLinking().RemoveLight(oldLight);
         _light = light;
-        _syncParams = spotLightSync;
-
-        return spotLightSync(*this, light, nentry, id, sceneDelegate);
+        nentry = AiNodeGetNodeEntry(light);
+        _params.clear();
+        iterateParams(*this, light, nentry, sceneDelegate, genericParams);
+    }
+    if (isSpot) {
+        spotLightSync(*this, light, nentry, id, sceneDelegate);
+    } else {
+        pointLightSync(*this, light, nentry, id, sceneDelegate);
     }
-    return pointLightSync(*this, light, nentry, id, sceneDelegate);
 }
 
 HdAiLight* HdAiLight::CreatePointSpotLight(
@@ -293,22 +333,32 @@ void HdAiLight::Sync(
     HdSceneDelegate* sceneDelegate, HdRenderParam* renderParam,
     HdDirtyBits* dirtyBits) {
     auto* param = reinterpret_cast<HdAiRenderParam*>(renderParam);
+    HdAiRenderStats::SyncTimer timer(param->GetStats(), _tokens->light);
     TF_UNUSED(sceneDelegate);
     TF_UNUSED(dirtyBits);
     if (*dirtyBits & HdLight::DirtyParams) {
-        param->End();
+        // The render is only interrupted once a parameter actually changed.
+        _renderParam = param;
         const auto id = GetId();
         const auto* nentry = AiNodeGetNodeEntry(_light);
-        iterateParams(_light, nentry, id, sceneDelegate, genericParams);
+        iterateParams(*this, _light, nentry, sceneDelegate, genericParams);
         _syncParams(*this, _light, nentry, id, sceneDelegate);
-        if (_supportsTexture) {
-            SetupTexture(sceneDelegate->GetLightParamValue(
-                id, HdLightTokens->textureFile));
+        VtValue textureFile;
+        if (_supportsTexture &&
+            UpdateParam(
+                sceneDelegate, HdLightTokens->textureFile, textureFile)) {
+            SetupTexture(textureFile);
         }
+        // The links are written to the shapes when committing the resources,
+        // the light itself doesn't change.
+        _delegate->GetLightLinking().SetLight(
+            _light, getLink(sceneDelegate, id, _tokens->lightLink),
+            getLink(sceneDelegate, id, _tokens->shadowLink));
+        _renderParam = nullptr;
     }
 
     if (*dirtyBits & HdLight::DirtyTransform) {
-        param->End();
+        param->Interrupt();
         HdAiSetTransform(_light, sceneDelegate, GetId());
     }
     *dirtyBits = HdLight::Clean;
@@ -325,6 +375,7 @@ void HdAiLight::SetupTexture(const VtValue& value) {
     }
     if (_texture != nullptr) {
         AiNodeDestroy(_texture);
+        _delegate->GetStats().NodeDestroyed();
         _texture = nullptr;
     }
     if (!value.IsHolding<SdfAssetPath>()) { return; }
@@ -334,6 +385,14 @@ void HdAiLight::SetupTexture(const VtValue& value) {
 
     if (path.empty()) { return; }
     _texture = AiNode(_delegate->GetUniverse(), imageStr);
+    _delegate->GetStats().NodeCreated();
+    // Named, so the texture cache can find it once the tx file is ready.
+    if (!GetId().IsEmpty()) {
+        AiNodeSetStr(
+            _texture, "name",
+            TfStringPrintf("%s/__texture", GetId().GetText()).c_str());
+    }
+    path = _delegate->GetTextureCache().Resolve(path, _texture, filenameStr);
     AiNodeSetStr(_texture, filenameStr, path.c_str());
     if (hasShader) {
         AiNodeSetPtr(_light, shaderStr, _texture);
@@ -342,6 +401,16 @@ void HdAiLight::SetupTexture(const VtValue& value) {
     }
 }
 
+bool HdAiLight::UpdateParam(
+    HdSceneDelegate* sceneDelegate, const TfToken& name, VtValue& value) {
+    value = sceneDelegate->GetLightParamValue(GetId(), name);
+    const auto it = _params.find(name);
+    if (it != _params.end() && it->second == value) { return false; }
+    _params[name] = value;
+    if (_renderParam != nullptr) { _renderParam->Interrupt(); }
+    return true;
+}
+
 HdDirtyBits HdAiLight::GetInitialDirtyBitsMask() const {
     return HdLight::DirtyParams | HdLight::DirtyTransform;
 }
@@ -359,11 +428,17 @@ HdAiLight::HdAiLight(
     } else {
         AiNodeSetStr(_light, "name", id.GetText());
     }
+    _delegate->GetStats().NodeCreated();
 }
 
 HdAiLight::~HdAiLight() {
+    _delegate->GetLightLinking().RemoveLight(_light);
     AiNodeDestroy(_light);
-    if (_texture != nullptr) { AiNodeDestroy(_texture); }
+    _delegate->GetStats().NodeDestroyed();
+    if (_texture != nullptr) {
+        AiNodeDestroy(_texture);
+        _delegate->GetStats().NodeDestroyed();
+    }
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -17,6 +17,7 @@
 #include <pxr/pxr.h>
 #include "pxr/imaging/hdAi/api.h"
 
+#include <pxr/base/tf/hashmap.h>
 #include <pxr/imaging/hd/light.h>
 
 #include "pxr/imaging/hdAi/renderDelegate.h"
@@ -58,6 +59,13 @@ public:
 
     HdDirtyBits GetInitialDirtyBitsMask() const override;
 
+    /// Reads the light parameter \p name into \p value, and returns true if
+    /// it changed since it was last read, so only the changed parameters are
+    /// written. The render is interrupted on the first change.
+    HDAI_API
+    bool UpdateParam(
+        HdSceneDelegate* sceneDelegate, const TfToken& name, VtValue& value);
+
 protected:
     using SyncParams = std::function<void(
         HdAiLight&, AtNode*, const AtNodeEntry*, const SdfPath&,
@@ -79,6 +87,10 @@ protected:
     HdAiRenderDelegate* _delegate;
     AtNode* _light;
     AtNode* _texture = nullptr;
+    /// Render param of the running sync.
+    HdAiRenderParam* _renderParam = nullptr;
+    /// Last values of the light parameters.
+    TfHashMap<TfToken, VtValue, TfToken::HashFunctor> _params;
     bool _supportsTexture = false;
 
 private:
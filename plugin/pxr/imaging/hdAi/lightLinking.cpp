@@ -0,0 +1,169 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/lightLinking.h"
+
+#include <algorithm>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+namespace Str {
+const AtString light_group("light_group");
+const AtString use_light_group("use_light_group");
+const AtString shadow_group("shadow_group");
+const AtString use_shadow_group("use_shadow_group");
+} // namespace Str
+
+inline bool _InCollection(
+    const TfToken& collection, const std::vector<TfToken>& categories) {
+    return collection.IsEmpty() ||
+           std::binary_search(
+               categories.begin(), categories.end(), collection,
+               TfTokenFastArbitraryLessThan());
+}
+
+void _SetGroup(
+    AtNode* shape, const AtString& group, const AtString& useGroup,
+    bool use, const std::vector<AtNode*>& nodes) {
+    AiNodeSetBool(shape, useGroup, use);
+    if (use) {
+        AiNodeSetArray(
+            shape, group,
+            AiArrayConvert(
+                static_cast<uint32_t>(nodes.size()), 1, AI_TYPE_NODE,
+                nodes.data()));
+    } else {
+        AiNodeResetParameter(shape, group.c_str());
+    }
+}
+
+} // namespace
+
+bool HdAiLightLinking::_IsLinked(const Links& links) {
+    return !links.lightLink.IsEmpty() || !links.shadowLink.IsEmpty();
+}
+
+bool HdAiLightLinking::CategoriesLess::operator()(
+    const std::vector<TfToken>& a, const std::vector<TfToken>& b) const {
+    return std::lexicographical_compare(
+        a.begin(), a.end(), b.begin(), b.end(),
+        TfTokenFastArbitraryLessThan());
+}
+
+void HdAiLightLinking::SetLight(
+    AtNode* light, const TfToken& lightLink, const TfToken& shadowLink) {
+    auto it = _lights.find(light);
+    if (it != _lights.end() && it->second.lightLink == lightLink &&
+        it->second.shadowLink == shadowLink) {
+        return;
+    }
+    const Links links{lightLink, shadowLink};
+    auto wasLinked = false;
+    if (it != _lights.end()) {
+        wasLinked = _IsLinked(it->second);
+        it->second = links;
+    } else {
+        _lights.emplace(light, links);
+    }
+    const auto isLinked = _IsLinked(links);
+    if (wasLinked) { _numLinked -= 1; }
+    if (isLinked) { _numLinked += 1; }
+    // Unlinked lights only change the groups if other lights are linked,
+    // otherwise every shape sees every light already.
+    _dirty = _dirty || wasLinked || isLinked || _numLinked > 0;
+}
+
+void HdAiLightLinking::RemoveLight(AtNode* light) {
+    auto it = _lights.find(light);
+    if (it == _lights.end()) { return; }
+    const auto wasLinked = _IsLinked(it->second);
+    if (wasLinked) { _numLinked -= 1; }
+    _lights.erase(it);
+    _dirty = _dirty || wasLinked || _numLinked > 0;
+}
+
+void HdAiLightLinking::SetShape(
+    AtNode* shape, const VtArray<TfToken>& categories) {
+    Categories sorted(categories.begin(), categories.end());
+    std::sort(sorted.begin(), sorted.end(), TfTokenFastArbitraryLessThan());
+    auto& stored = _shapes[shape];
+    stored.swap(sorted);
+    // Every shape is written by the next update anyway.
+    if (!_dirty) { _Write(shape, stored); }
+}
+
+void HdAiLightLinking::SetInstances(
+    AtNode* prototype, const std::vector<AtNode*>& instances) {
+    // Copied, as adding the instances might rehash the shapes.
+    const auto it = _shapes.find(prototype);
+    const auto categories = it == _shapes.end() ? Categories() : it->second;
+    for (auto* instance : instances) {
+        auto& stored = _shapes[instance];
+        stored = categories;
+        if (!_dirty) { _Write(instance, stored); }
+    }
+}
+
+void HdAiLightLinking::ReplaceShape(AtNode* from, AtNode* to) {
+    auto it = _shapes.find(from);
+    if (it == _shapes.end()) { return; }
+    auto categories = std::move(it->second);
+    _shapes.erase(it);
+    auto& stored = _shapes[to];
+    stored.swap(categories);
+    if (!_dirty) { _Write(to, stored); }
+}
+
+void HdAiLightLinking::RemoveShape(AtNode* shape) { _shapes.erase(shape); }
+
+void HdAiLightLinking::Update(HdAiRenderParam& param) {
+    if (!_dirty) { return; }
+    _dirty = false;
+    _groups.clear();
+    if (_shapes.empty()) { return; }
+    param.Interrupt();
+    for (const auto& shape : _shapes) { _Write(shape.first, shape.second); }
+}
+
+const HdAiLightLinking::Groups& HdAiLightLinking::_GetGroups(
+    const Categories& categories) {
+    auto it = _groups.find(categories);
+    if (it != _groups.end()) { return it->second; }
+    auto& groups = _groups[categories];
+    for (const auto& light : _lights) {
+        if (_InCollection(light.second.lightLink, categories)) {
+            groups.lights.push_back(light.first);
+        } else {
+            groups.useLights = true;
+        }
+        if (_InCollection(light.second.shadowLink, categories)) {
+            groups.shadows.push_back(light.first);
+        } else {
+            groups.useShadows = true;
+        }
+    }
+    return groups;
+}
+
+void HdAiLightLinking::_Write(AtNode* shape, const Categories& categories) {
+    const auto& groups = _GetGroups(categories);
+    _SetGroup(
+        shape, Str::light_group, Str::use_light_group, groups.useLights,
+        groups.lights);
+    _SetGroup(
+        shape, Str::shadow_group, Str::use_shadow_group, groups.useShadows,
+        groups.shadows);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
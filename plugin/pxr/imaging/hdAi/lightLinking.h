@@ -0,0 +1,113 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_LIGHT_LINKING_H
+#define HDAI_LIGHT_LINKING_H
+
+#include <pxr/pxr.h>
+#include "pxr/imaging/hdAi/api.h"
+
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/array.h>
+
+#include "pxr/imaging/hdAi/renderParam.h"
+
+#include <ai.h>
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Translates light linking and shadow linking to the light_group and
+/// shadow_group of the shapes.
+///
+/// Lights register the collections they illuminate and shadow, an empty
+/// collection meaning every shape, and shapes register the collections they
+/// belong to. The groups only depend on the set of collections of a shape, so
+/// they are computed once for each unique set, and only computed again when a
+/// light changes.
+///
+/// The registry is only accessed while syncing lights, committing the staged
+/// writes, or creating and destroying prims, so it's not thread-safe.
+class HdAiLightLinking {
+public:
+    /// Sets the light and shadow link collections of \p light.
+    HDAI_API
+    void SetLight(
+        AtNode* light, const TfToken& lightLink, const TfToken& shadowLink);
+
+    /// Removes \p light, before it's destroyed.
+    HDAI_API
+    void RemoveLight(AtNode* light);
+
+    /// Sets the collections \p shape belongs to, and writes its groups.
+    HDAI_API
+    void SetShape(AtNode* shape, const VtArray<TfToken>& categories);
+
+    /// Gives the ginstance nodes \p instances the collections of
+    /// \p prototype, and writes their groups. The prototype is hidden, so
+    /// its groups are not used by the instances.
+    HDAI_API
+    void SetInstances(AtNode* prototype, const std::vector<AtNode*>& instances);
+
+    /// Moves the collections of \p from to \p to, when a shape is rendered
+    /// through a different node.
+    HDAI_API
+    void ReplaceShape(AtNode* from, AtNode* to);
+
+    /// Removes \p shape, before it's destroyed.
+    HDAI_API
+    void RemoveShape(AtNode* shape);
+
+    /// Writes the groups of every shape if a light changed since the last
+    /// call, interrupting the render through \p param.
+    HDAI_API
+    void Update(HdAiRenderParam& param);
+
+private:
+    struct Links {
+        TfToken lightLink;
+        TfToken shadowLink;
+    };
+
+    struct Groups {
+        std::vector<AtNode*> lights;
+        std::vector<AtNode*> shadows;
+        bool useLights = false;
+        bool useShadows = false;
+    };
+
+    struct CategoriesLess {
+        bool operator()(
+            const std::vector<TfToken>& a,
+            const std::vector<TfToken>& b) const;
+    };
+
+    using Categories = std::vector<TfToken>;
+
+    static bool _IsLinked(const Links& links);
+    const Groups& _GetGroups(const Categories& categories);
+    void _Write(AtNode* shape, const Categories& categories);
+
+    std::unordered_map<AtNode*, Links> _lights;
+    std::unordered_map<AtNode*, Categories> _shapes;
+    std::map<Categories, Groups, CategoriesLess> _groups;
+    size_t _numLinked = 0;
+    bool _dirty = false;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_LIGHT_LINKING_H
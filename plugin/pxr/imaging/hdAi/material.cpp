@@ -13,33 +13,198 @@
 // limitations under the License.
 #include "pxr/imaging/hdAi/material.h"
 
+#include <pxr/base/arch/hash.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/sdf/assetPath.h>
+
 #include <pxr/usdImaging/usdImaging/tokens.h>
 
+#include "pxr/imaging/hdAi/config.h"
 #include "pxr/imaging/hdAi/debugCodes.h"
 #include "pxr/imaging/hdAi/utils.h"
 
+#include <algorithm>
+#include <set>
+#include <tuple>
+#include <unordered_set>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 namespace {
 const AtString nameStr("name");
+
+using _RelationshipKey = std::tuple<SdfPath, TfToken, SdfPath, TfToken>;
+
+inline _RelationshipKey _GetKey(const HdMaterialRelationship& relationship) {
+    return std::make_tuple(
+        relationship.inputId, relationship.inputName, relationship.outputId,
+        relationship.outputName);
+}
+
+inline AtString _GetNodeType(const HdMaterialNode& node) {
+    const auto* nodeTypeStr = node.identifier.GetText();
+    return AtString(
+        strncmp(nodeTypeStr, "ai:", 3) == 0 ? nodeTypeStr + 3 : nodeTypeStr);
+}
+
+using _NodeMap =
+    std::unordered_map<SdfPath, const HdMaterialNode*, SdfPath::Hash>;
+using _InputMap = std::unordered_map<
+    SdfPath, std::vector<const HdMaterialRelationship*>, SdfPath::Hash>;
+using _HashMap = std::unordered_map<SdfPath, size_t, SdfPath::Hash>;
+
+// Hashes the subgraph ending in the node at \p path, and appends the nodes
+// of the subgraph to \p order, so inputs come before the nodes they feed.
+size_t _HashSubgraph(
+    const SdfPath& path, const _NodeMap& nodes, const _InputMap& inputs,
+    size_t salt, _HashMap& hashes,
+    std::vector<const HdMaterialNode*>& order) {
+    const auto cached = hashes.find(path);
+    if (cached != hashes.end()) { return cached->second; }
+    const auto nodeIt = nodes.find(path);
+    if (nodeIt == nodes.end()) { return 0; }
+    // Guards against cycles.
+    hashes[path] = 0;
+    const auto* node = nodeIt->second;
+    std::vector<size_t> values{node->identifier.Hash(), salt};
+    for (const auto& param : node->parameters) {
+        values.push_back(param.first.Hash());
+        values.push_back(param.second.GetHash());
+    }
+    const auto inputsIt = inputs.find(path);
+    if (inputsIt != inputs.end()) {
+        // The order of the relationships is not significant.
+        auto relationships = inputsIt->second;
+        std::sort(
+            relationships.begin(), relationships.end(),
+            [](const HdMaterialRelationship* a,
+               const HdMaterialRelationship* b) -> bool {
+                return std::tie(a->outputName, a->inputName) <
+                       std::tie(b->outputName, b->inputName);
+            });
+        for (const auto* relationship : relationships) {
+            values.push_back(relationship->outputName.Hash());
+            values.push_back(relationship->inputName.Hash());
+            values.push_back(_HashSubgraph(
+                relationship->inputId, nodes, inputs, salt, hashes, order));
+        }
+    }
+    const auto hash = static_cast<size_t>(ArchHash64(
+        reinterpret_cast<const char*>(values.data()),
+        values.size() * sizeof(size_t)));
+    hashes[path] = hash;
+    order.push_back(node);
+    return hash;
 }
 
+// Writes the parameters of \p node that differ from \p previous, and resets
+// the ones that are no longer authored.
+void _SetParameters(
+    AtNode* shader, const HdMaterialNode& node, const HdMaterialNode* previous,
+    HdAiTextureCache& textureCache) {
+    const auto* nentry = AiNodeGetNodeEntry(shader);
+    for (const auto& param : node.parameters) {
+        const auto& paramName = param.first;
+        if (previous != nullptr) {
+            const auto it = previous->parameters.find(paramName);
+            if (it != previous->parameters.end() &&
+                it->second == param.second) {
+                continue;
+            }
+        }
+        const auto* pentry =
+            AiNodeEntryLookUpParameter(nentry, AtString(paramName.GetText()));
+        if (pentry == nullptr) { continue; }
+        // Textures are switched to their tx files once converted.
+        if (AiParamGetType(pentry) == AI_TYPE_STRING &&
+            param.second.IsHolding<SdfAssetPath>()) {
+            const auto& assetPath = param.second.UncheckedGet<SdfAssetPath>();
+            AiNodeSetStr(
+                shader, AiParamGetName(pentry),
+                textureCache
+                    .Resolve(
+                        assetPath.GetResolvedPath().empty()
+                            ? assetPath.GetAssetPath()
+                            : assetPath.GetResolvedPath(),
+                        shader, AiParamGetName(pentry))
+                    .c_str());
+            continue;
+        }
+        HdAiSetParameter(shader, pentry, param.second);
+    }
+    if (previous == nullptr) { return; }
+    for (const auto& param : previous->parameters) {
+        const auto& paramName = param.first;
+        if (node.parameters.find(paramName) != node.parameters.end() ||
+            AiNodeEntryLookUpParameter(
+                nentry, AtString(paramName.GetText())) == nullptr) {
+            continue;
+        }
+        AiNodeResetParameter(shader, paramName.GetText());
+    }
+}
+
+void _Link(
+    AtNode* inputNode, AtNode* outputNode,
+    const HdMaterialRelationship& relationship) {
+    // See if the inputName is a single channel we recognize
+    if (relationship.inputName.size() == 1) {
+        const char* inputName = relationship.inputName.GetText();
+        if (inputName[0] == 'r' || inputName[0] == 'g' ||
+            inputName[0] == 'b' || inputName[0] == 'a' ||
+            inputName[0] == 'x' || inputName[0] == 'y' ||
+            inputName[0] == 'z' || inputName[0] == 'w') {
+            TF_DEBUG(HDAI_MATERIAL)
+                .Msg(
+                    "HdAiMaterial::ReadMaterialNetwork - Linking %s.%s => "
+                    "%s.%s\n",
+                    relationship.inputId.GetText(),
+                    relationship.inputName.GetText(),
+                    relationship.outputId.GetText(),
+                    relationship.outputName.GetText());
+            AiNodeLinkOutput(
+                inputNode, inputName, outputNode,
+                relationship.outputName.GetText());
+            return;
+        }
+    }
+    TF_DEBUG(HDAI_MATERIAL)
+        .Msg(
+            "HdAiMaterial::ReadMaterialNetwork - Linking %s => %s.%s\n",
+            relationship.inputId.GetText(), relationship.outputId.GetText(),
+            relationship.outputName.GetText());
+    AiNodeLink(inputNode, relationship.outputName.GetText(), outputNode);
+}
+
+} // namespace
+
 HdAiMaterial::HdAiMaterial(HdAiRenderDelegate* delegate, const SdfPath& id)
     : HdMaterial(id), _delegate(delegate) {
     _surface = _delegate->GetFallbackShader();
 }
 
 HdAiMaterial::~HdAiMaterial() {
-    for (auto& node : _nodes) { AiNodeDestroy(node.second); }
+    auto& registry = _delegate->GetShaderRegistry();
+    for (auto& node : _nodes) {
+        const auto hashIt = _hashes.find(node.first);
+        if (hashIt != _hashes.end()) {
+            registry.Release(hashIt->second);
+        } else {
+            AiNodeDestroy(node.second);
+            _delegate->GetStats().NodeDestroyed();
+        }
+    }
 }
 
 void HdAiMaterial::Sync(
     HdSceneDelegate* sceneDelegate, HdRenderParam* renderParam,
     HdDirtyBits* dirtyBits) {
     auto* param = reinterpret_cast<HdAiRenderParam*>(renderParam);
+    HdAiRenderStats::SyncTimer timer(
+        param->GetStats(), HdPrimTypeTokens->material);
     const auto id = GetId();
     if ((*dirtyBits & HdMaterial::DirtyResource) && !id.IsEmpty()) {
-        param->End();
+        param->Interrupt();
         auto value = sceneDelegate->GetMaterialResource(GetId());
         if (value.IsHolding<HdMaterialNetworkMap>()) {
             const auto& map = value.UncheckedGet<HdMaterialNetworkMap>();
@@ -47,8 +212,15 @@ void HdAiMaterial::Sync(
                 TfMapLookupPtr(map.map, UsdImagingTokens->bxdf);
             if (network != nullptr) {
                 auto* entry = ReadMaterialNetwork(*network);
-                _surface =
+                auto* surface =
                     entry == nullptr ? _delegate->GetFallbackShader() : entry;
+                // The shapes only pick up the shader when their material
+                // binding is dirty, and the old one might be destroyed.
+                if (surface != _surface) {
+                    _surface = surface;
+                    _delegate->GetMaterialBindings().MarkRprimsDirty(
+                        id, sceneDelegate->GetRenderIndex().GetChangeTracker());
+                }
             }
         }
     }
@@ -72,62 +244,205 @@ AtNode* HdAiMaterial::ReadMaterialNetwork(const HdMaterialNetwork& network) {
             GetId().GetText(), network.nodes.size());
     if (network.nodes.empty()) { return nullptr; }
 
-    std::vector<AtNode*> nodes;
-    nodes.reserve(network.nodes.size());
+    _NodeMap nodes;
+    for (const auto& node : network.nodes) { nodes.emplace(node.path, &node); }
+    // The network is diffed against the last applied one, so editing a
+    // single parameter doesn't rewrite every node and link.
+    _NodeMap previousNodes;
+    for (const auto& node : _network.nodes) {
+        previousNodes.emplace(node.path, &node);
+    }
+    _InputMap inputs;
+    std::unordered_set<SdfPath, SdfPath::Hash> usedAsInput;
+    std::set<_RelationshipKey> relationships;
+    for (const auto& relationship : network.relationships) {
+        inputs[relationship.outputId].push_back(&relationship);
+        usedAsInput.insert(relationship.inputId);
+        relationships.insert(_GetKey(relationship));
+    }
+    _InputMap previousInputs;
+    std::set<_RelationshipKey> previousRelationships;
+    for (const auto& relationship : _network.relationships) {
+        previousInputs[relationship.outputId].push_back(&relationship);
+        previousRelationships.insert(_GetKey(relationship));
+    }
+
+    // The terminal is the first node not feeding any other node.
+    const HdMaterialNode* terminal = nullptr;
     for (const auto& node : network.nodes) {
-        auto* n = ReadMaterial(node);
-        if (n != nullptr) { nodes.push_back(n); }
+        if (usedAsInput.find(node.path) == usedAsInput.end()) {
+            terminal = &node;
+            break;
+        }
     }
+    if (terminal == nullptr) { return nullptr; }
 
-    for (const auto& relationship : network.relationships) {
-        auto* inputNode = FindMaterial(relationship.inputId);
-        if (inputNode == nullptr) { continue; }
-        std::remove(nodes.begin(), nodes.end(), inputNode);
-        auto* outputNode = FindMaterial(relationship.outputId);
-        if (outputNode == nullptr) { continue; }
-
-        // See if the inputName is a single channel we recognize
-        bool usedInputName = false;
-        if (relationship.inputName.size() == 1) {
-            const char* inputName = relationship.inputName.GetText();
-            if (inputName[0] == 'r' || inputName[0] == 'g' ||
-                inputName[0] == 'b' || inputName[0] == 'a' ||
-                inputName[0] == 'x' || inputName[0] == 'y' ||
-                inputName[0] == 'z' || inputName[0] == 'w') {
-                usedInputName = true;
+    // Every node feeding the terminal is keyed by the hash of its subgraph,
+    // so materials sharing a subgraph share its Arnold nodes. The salt keeps
+    // the nodes private when sharing is disabled.
+    const auto salt = HdAiConfig::GetInstance().deduplicate_shaders
+                          ? size_t{0}
+                          : SdfPath::Hash()(GetId());
+    _HashMap hashes;
+    std::vector<const HdMaterialNode*> order;
+    _HashSubgraph(terminal->path, nodes, inputs, salt, hashes, order);
+
+    auto& registry = _delegate->GetShaderRegistry();
+    auto oldNodes = std::move(_nodes);
+    auto oldHashes = std::move(_hashes);
+    _nodes.clear();
+    _hashes.clear();
+    // Nodes are only released once the new network is linked, so no link
+    // points to a destroyed node.
+    std::vector<size_t> releasedHashes;
+    std::vector<AtNode*> destroyedNodes;
+
+    const auto findPrevious =
+        [&previousNodes](const SdfPath& path) -> const HdMaterialNode* {
+        const auto it = previousNodes.find(path);
+        return it == previousNodes.end() ? nullptr : it->second;
+    };
+    // Unlinks the inputs of \p node that are gone, and links the inputs that
+    // are new or whose node changed.
+    const auto updateLinks = [&](const HdMaterialNode& node, AtNode* shader,
+                                 bool created) {
+        if (!created) {
+            const auto it = previousInputs.find(node.path);
+            if (it != previousInputs.end()) {
+                for (const auto* relationship : it->second) {
+                    if (relationships.find(_GetKey(*relationship)) ==
+                        relationships.end()) {
+                        AiNodeUnlink(
+                            shader, relationship->outputName.GetText());
+                    }
+                }
+            }
+        }
+        const auto it = inputs.find(node.path);
+        if (it == inputs.end()) { return; }
+        for (const auto* relationship : it->second) {
+            auto* inputNode = FindMaterial(relationship->inputId);
+            if (inputNode == nullptr) { continue; }
+            const auto oldInput =
+                oldNodes.find(GetLocalNodeName(relationship->inputId));
+            if (!created &&
+                previousRelationships.find(_GetKey(*relationship)) !=
+                    previousRelationships.end() &&
+                oldInput != oldNodes.end() && oldInput->second == inputNode) {
+                continue;
+            }
+            _Link(inputNode, shader, *relationship);
+        }
+    };
+
+    for (const auto* node : order) {
+        const auto name = GetLocalNodeName(node->path);
+        const auto oldNode = oldNodes.find(name);
+        const auto oldHash = oldHashes.find(name);
+        if (node == terminal) {
+            // The terminal stays private, so editing its parameters doesn't
+            // change the shader the shapes point to.
+            if (oldHash != oldHashes.end()) {
+                releasedHashes.push_back(oldHash->second);
+            } else if (oldNode != oldNodes.end()) {
+                _nodes.emplace(name, oldNode->second);
+                oldNodes.erase(oldNode);
+            }
+            auto created = false;
+            auto* shader =
+                ReadMaterial(*node, findPrevious(node->path), created);
+            if (shader != nullptr) { updateLinks(*node, shader, created); }
+            continue;
+        }
+
+        const auto hash = hashes[node->path];
+        if (oldHash != oldHashes.end() && oldHash->second == hash) {
+            // Same subgraph, nothing to update.
+            _nodes.emplace(name, oldNode->second);
+            _hashes.emplace(name, hash);
+            continue;
+        }
+        auto* shader = registry.Acquire(hash);
+        auto created = false;
+        if (shader == nullptr) {
+            const auto nodeType = _GetNodeType(*node);
+            const auto shaderName =
+                TfStringPrintf("/__hdAiShader_%zx", hash);
+            if (oldHash != oldHashes.end() &&
+                registry.IsUnique(oldHash->second) &&
+                AiNodeEntryGetNameAtString(
+                    AiNodeGetNodeEntry(oldNode->second)) == nodeType) {
+                // Nobody else uses the node, so it's edited in place.
+                shader = oldNode->second;
+                registry.Rekey(oldHash->second, hash);
+                // The unchanged parameters are not resolved again, so their
+                // pending textures follow the new name.
+                const AtString newName(shaderName.c_str());
+                _delegate->GetTextureCache().RenameNode(
+                    AtString(AiNodeGetName(shader)), newName);
+                AiNodeSetStr(shader, nameStr, newName);
+                _SetParameters(
+                    shader, *node, findPrevious(node->path),
+                    _delegate->GetTextureCache());
+                _nodes.emplace(name, shader);
+                _hashes.emplace(name, hash);
+                updateLinks(*node, shader, false);
+                continue;
+            }
+            shader = AiNode(_delegate->GetUniverse(), nodeType);
+            if (shader == nullptr) {
                 TF_DEBUG(HDAI_MATERIAL)
                     .Msg(
-                        "HdAiMaterial::ReadMaterialNetwork - Linking %s.%s => "
-                        "%s.%s\n",
-                        relationship.inputId.GetText(),
-                        relationship.inputName.GetText(),
-                        relationship.outputId.GetText(),
-                        relationship.outputName.GetText());
-                AiNodeLinkOutput(
-                    inputNode, inputName, outputNode,
-                    relationship.outputName.GetText());
+                        "  unable to create node of type %s - skipping\n",
+                        nodeType.c_str());
+                continue;
             }
+            _delegate->GetStats().NodeCreated();
+            AiNodeSetStr(shader, nameStr, shaderName.c_str());
+            registry.Insert(hash, shader);
+            _SetParameters(
+                shader, *node, nullptr, _delegate->GetTextureCache());
+            created = true;
         }
-        if (!usedInputName) {
-            TF_DEBUG(HDAI_MATERIAL)
-                .Msg(
-                    "HdAiMaterial::ReadMaterialNetwork - Linking %s => %s.%s\n",
-                    relationship.inputId.GetText(),
-                    relationship.outputId.GetText(),
-                    relationship.outputName.GetText());
-            AiNodeLink(
-                inputNode, relationship.outputName.GetText(), outputNode);
+        if (oldHash != oldHashes.end()) {
+            releasedHashes.push_back(oldHash->second);
+        } else if (oldNode != oldNodes.end()) {
+            destroyedNodes.push_back(oldNode->second);
         }
+        _nodes.emplace(name, shader);
+        _hashes.emplace(name, hash);
+        if (created) { updateLinks(*node, shader, true); }
     }
 
-    return nodes.empty() ? nullptr : nodes.front();
+    // Nodes that are no longer part of the network.
+    for (const auto& oldNode : oldNodes) {
+        if (_nodes.find(oldNode.first) != _nodes.end()) { continue; }
+        const auto oldHash = oldHashes.find(oldNode.first);
+        if (oldHash != oldHashes.end()) {
+            releasedHashes.push_back(oldHash->second);
+        } else if (oldNode.second != nullptr) {
+            destroyedNodes.push_back(oldNode.second);
+        }
+    }
+    for (const auto hash : releasedHashes) { registry.Release(hash); }
+    for (auto* node : destroyedNodes) {
+        TF_DEBUG(HDAI_MATERIAL)
+            .Msg(
+                "HdAiMaterial::ReadMaterialNetwork - Destroying %s\n",
+                AiNodeGetName(node));
+        AiNodeDestroy(node);
+        _delegate->GetStats().NodeDestroyed();
+    }
+
+    _network = network;
+    return FindMaterial(terminal->path);
 }
 
-AtNode* HdAiMaterial::ReadMaterial(const HdMaterialNode& material) {
+AtNode* HdAiMaterial::ReadMaterial(
+    const HdMaterialNode& material, const HdMaterialNode* previous,
+    bool& created) {
     const auto nodeName = GetLocalNodeName(material.path);
-    const auto* nodeTypeStr = material.identifier.GetText();
-    const AtString nodeType(
-        strncmp(nodeTypeStr, "ai:", 3) == 0 ? nodeTypeStr + 3 : nodeTypeStr);
+    const auto nodeType = _GetNodeType(material);
 
     TF_DEBUG(HDAI_MATERIAL)
         .Msg(
@@ -143,6 +458,7 @@ AtNode* HdAiMaterial::ReadMaterial(const HdMaterialNode& material) {
                     "  existing node found, but type mismatch - deleting old "
                     "node\n");
             AiNodeDestroy(nodeIt->second);
+            _delegate->GetStats().NodeDestroyed();
             _nodes.erase(nodeIt);
         } else {
             TF_DEBUG(HDAI_MATERIAL).Msg("  existing node found - using it\n");
@@ -160,18 +476,16 @@ AtNode* HdAiMaterial::ReadMaterial(const HdMaterialNode& material) {
         }
         TF_DEBUG(HDAI_MATERIAL)
             .Msg("  created node of type %s\n", nodeType.c_str());
+        _delegate->GetStats().NodeCreated();
         AiNodeSetStr(ret, nameStr, nodeName);
         _nodes.emplace(nodeName, ret);
+        created = true;
     }
 
-    const auto* nentry = AiNodeGetNodeEntry(ret);
-    for (const auto& param : material.parameters) {
-        const auto& paramName = param.first;
-        const auto* pentry =
-            AiNodeEntryLookUpParameter(nentry, AtString(paramName.GetText()));
-        if (pentry == nullptr) { continue; }
-        HdAiSetParameter(ret, pentry, param.second);
-    }
+    // A new node has no state, so every parameter is written.
+    _SetParameters(
+        ret, material, created ? nullptr : previous,
+        _delegate->GetTextureCache());
     return ret;
 }
 
@@ -52,8 +52,14 @@ protected:
     HDAI_API
     AtNode* ReadMaterialNetwork(const HdMaterialNetwork& network);
 
+    /// Creates or updates the private Arnold node of \p node. Only the
+    /// parameters that differ from \p previous, the same node in the last
+    /// applied network, are written. \p created is set if a new node was
+    /// created.
     HDAI_API
-    AtNode* ReadMaterial(const HdMaterialNode& node);
+    AtNode* ReadMaterial(
+        const HdMaterialNode& node, const HdMaterialNode* previous,
+        bool& created);
 
     HDAI_API
     AtNode* FindMaterial(const SdfPath& id) const;
@@ -62,6 +68,12 @@ protected:
     AtString GetLocalNodeName(const SdfPath& path) const;
 
     std::unordered_map<AtString, AtNode*, AtStringHash> _nodes;
+    /// Subgraph hashes of the nodes shared through the shader registry. The
+    /// terminal node is private to the material.
+    std::unordered_map<AtString, size_t, AtStringHash> _hashes;
+    /// The last network applied to the nodes, used to only write the
+    /// changes.
+    HdMaterialNetwork _network;
     HdAiRenderDelegate* _delegate;
     AtNode* _surface = nullptr;
     AtNode* _displacement = nullptr;
@@ -0,0 +1,60 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_MATERIAL_BINDINGS_H
+#define HDAI_MATERIAL_BINDINGS_H
+
+#include <pxr/pxr.h>
+#include "pxr/imaging/hdAi/api.h"
+
+#include <pxr/imaging/hd/changeTracker.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <unordered_map>
+#include <unordered_set>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Records the material bound to each rprim, so a material whose surface
+/// shader changes only marks the rprims bound to it dirty.
+///
+/// Rprims record their binding from their staged writes, and materials query
+/// the bindings while syncing, which is serial, so it's not thread-safe.
+/// Rprims synced for the first time are not bound yet, and they read the
+/// shaders of the materials synced before them anyway.
+class HdAiMaterialBindings {
+public:
+    /// Binds \p rprimId to \p materialId, replacing its previous binding. An
+    /// empty \p materialId removes the binding.
+    HDAI_API
+    void Bind(const SdfPath& rprimId, const SdfPath& materialId);
+
+    /// Removes the binding of \p rprimId, before it's destroyed.
+    HDAI_API
+    void Unbind(const SdfPath& rprimId);
+
+    /// Marks the rprims bound to \p materialId with DirtyMaterialId.
+    HDAI_API
+    void MarkRprimsDirty(
+        const SdfPath& materialId, HdChangeTracker& tracker) const;
+
+private:
+    using PathSet = std::unordered_set<SdfPath, SdfPath::Hash>;
+
+    std::unordered_map<SdfPath, SdfPath, SdfPath::Hash> _materials;
+    std::unordered_map<SdfPath, PathSet, SdfPath::Hash> _rprims;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_MATERIAL_BINDINGS_H
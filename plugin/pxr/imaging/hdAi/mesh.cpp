@@ -13,13 +13,20 @@
 // limitations under the License.
 #include "pxr/imaging/hdAi/mesh.h"
 
+#include <pxr/base/arch/hash.h>
 #include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
 
+#include <pxr/imaging/hdAi/config.h>
+#include <pxr/imaging/hdAi/instancer.h>
 #include <pxr/imaging/hdAi/material.h>
 #include <pxr/imaging/hdAi/utils.h>
 
 #include <pxr/imaging/pxOsd/tokens.h>
 
+#include <algorithm>
+#include <vector>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 TF_DEFINE_PRIVATE_TOKENS(_tokens, (st)(uv));
@@ -34,6 +41,8 @@ const AtString vidxs("vidxs");
 const AtString nsides("nsides");
 const AtString uvlist("uvlist");
 const AtString uvidxs("uvidxs");
+const AtString nlist("nlist");
+const AtString nidxs("nidxs");
 const AtString shader("shader");
 const AtString disp_map("disp_map");
 const AtString opaque("opaque");
@@ -43,9 +52,101 @@ const AtString none("none");
 const AtString subdiv_iterations("subdiv_iterations");
 const AtString crease_idxs("crease_idxs");
 const AtString crease_sharpness("crease_sharpness");
-
+const AtString matrix("matrix");
+const AtString ginstance("ginstance");
+const AtString node("node");
+const AtString inherit_xform("inherit_xform");
 } // namespace Str
 
+// Hashes the contents of an array that is not attached to a node yet.
+size_t _HashArray(AtArray* arr, size_t seed) {
+    if (arr == nullptr) { return seed; }
+    const auto bytes = static_cast<size_t>(AiArrayGetNumElements(arr)) *
+                       AiArrayGetNumKeys(arr) *
+                       AiParamGetTypeSize(AiArrayGetType(arr));
+    if (bytes == 0) { return seed; }
+    const auto hash = ArchHash64(
+        static_cast<const char*>(AiArrayMap(arr)), bytes,
+        static_cast<uint64_t>(seed));
+    AiArrayUnmap(arr);
+    return static_cast<size_t>(hash);
+}
+
+// Converts the face-varying \p value either to its welded, indexed form, or
+// as is with identity indices. Welding is timed, so hosts can see its cost.
+template <typename T>
+void _ConvertFaceVarying(
+    const VtValue& value, uint8_t arnoldType, bool weld,
+    HdAiRenderStats& stats, AtArray*& values, AtArray*& indices) {
+    if (weld) {
+        const auto start = HdAiRenderStats::Clock::now();
+        TfToken type;
+        HdAiWeldFaceVarying(value, false, type, values, indices);
+        stats.AddWeldTime(start);
+        return;
+    }
+    const auto& v = value.UncheckedGet<VtArray<T>>();
+    const auto numElements = static_cast<uint32_t>(v.size());
+    values = AiArrayConvert(numElements, 1, arnoldType, v.cdata());
+    indices = HdAiGenerateIdentityIndices(numElements);
+}
+
+// Primvar read on the sync thread, and written to the mesh when the staged
+// writes are committed.
+struct _Primvar {
+    TfToken name;
+    TfToken role;
+    HdInterpolation interpolation;
+    VtValue value;
+};
+
+// Hashes a primvar, including how it's interpolated, so a primvar changing
+// its interpolation is declared again.
+size_t _HashPrimvar(
+    const VtValue& value, const TfToken& role, HdInterpolation interpolation) {
+    const size_t hashes[] = {value.GetHash(), role.Hash(),
+                             static_cast<size_t>(interpolation)};
+    return static_cast<size_t>(ArchHash64(
+        reinterpret_cast<const char*>(hashes), sizeof(hashes)));
+}
+
+// Face-varying primvar already welded into its indexed form.
+struct _IndexedPrimvar {
+    TfToken name;
+    TfToken type;
+    AtArray* values;
+    AtArray* indices;
+};
+
+// Writes the normals to the mesh. Arnold requires the same number of keys
+// for the positions and the normals, so the first key of the normals is
+// repeated for each deformation key. When no indices are passed, the normals
+// share the vertex indices.
+void _SetNormals(AtNode* mesh, AtArray* nlist, AtArray* nidxs) {
+    const auto* vlist = AiNodeGetArray(mesh, Str::vlist);
+    const auto numKeys = vlist == nullptr ? 1 : AiArrayGetNumKeys(vlist);
+    if (numKeys != AiArrayGetNumKeys(nlist)) {
+        const auto numElements = AiArrayGetNumElements(nlist);
+        auto* keys = AiArrayAllocate(numElements, numKeys, AI_TYPE_VECTOR);
+        if (numElements > 0) {
+            const auto* src = static_cast<const AtVector*>(AiArrayMap(nlist));
+            auto* dst = static_cast<AtVector*>(AiArrayMap(keys));
+            for (auto key = decltype(numKeys){0}; key < numKeys; ++key) {
+                std::copy(src, src + numElements, dst + key * numElements);
+            }
+            AiArrayUnmap(keys);
+            AiArrayUnmap(nlist);
+        }
+        AiArrayDestroy(nlist);
+        nlist = keys;
+    }
+    AiNodeSetArray(mesh, Str::nlist, nlist);
+    AiNodeSetArray(
+        mesh, Str::nidxs,
+        nidxs != nullptr ? nidxs
+                         : AiArrayCopy(AiNodeGetArray(mesh, Str::vidxs)));
+}
+
 } // namespace
 
 HdAiMesh::HdAiMesh(
@@ -55,88 +156,172 @@ HdAiMesh::HdAiMesh(
     AiNodeSetStr(_mesh, Str::name, id.GetText());
     // The default value is 1, which won't work well in a Hydra context.
     AiNodeSetByte(_mesh, Str::subdiv_iterations, 0);
+    _delegate->GetStats().NodeCreated();
 }
 
-HdAiMesh::~HdAiMesh() { AiNodeDestroy(_mesh); }
+HdAiMesh::~HdAiMesh() {
+    _delegate->GetMaterialBindings().Unbind(GetId());
+    auto& lightLinking = _delegate->GetLightLinking();
+    lightLinking.RemoveShape(_mesh);
+    if (_sharedInstance != nullptr) {
+        lightLinking.RemoveShape(_sharedInstance);
+        AiNodeDestroy(_sharedInstance);
+        _delegate->GetStats().NodeDestroyed();
+    }
+    if (_registered) {
+        _delegate->GetGeometryRegistry().Unregister(this, _registeredHash);
+    }
+    // The instancer might be already destroyed.
+    for (auto* instance : _instances) {
+        lightLinking.RemoveShape(instance);
+        AiNodeDestroy(instance);
+    }
+    _delegate->GetStats().NodeDestroyed(_instances.size());
+    AiNodeDestroy(_mesh);
+    _delegate->GetStats().NodeDestroyed();
+}
 
 void HdAiMesh::Sync(
     HdSceneDelegate* delegate, HdRenderParam* renderParam,
     HdDirtyBits* dirtyBits, const TfToken& reprToken) {
     auto* param = reinterpret_cast<HdAiRenderParam*>(renderParam);
+    HdAiRenderStats::SyncTimer timer(
+        param->GetStats(), HdPrimTypeTokens->mesh);
+    auto bits = *dirtyBits;
+    _Translate(delegate, param, &bits);
+    auto eligible = _IsShareable();
+    auto hash = _GetGeometryHash();
+    // A polymesh leaving its group of shared geometry only got the changed
+    // parts, so the whole mesh is pulled again in the same sync and shown
+    // when the sync is committed.
+    const auto allDirty = GetInitialDirtyBitsMask();
+    if (_geometryReleased && _registered &&
+        (!eligible || hash != _registeredHash) &&
+        (*dirtyBits & allDirty) != allDirty) {
+        bits = allDirty;
+        _Translate(delegate, param, &bits);
+        eligible = _IsShareable();
+        hash = _GetGeometryHash();
+    }
+    param->Stage([this, eligible, hash]() {
+        _UpdateSharedGeometry(eligible, hash);
+    });
+
+    *dirtyBits = HdChangeTracker::Clean;
+}
+
+void HdAiMesh::_Translate(
+    HdSceneDelegate* delegate, HdAiRenderParam* param,
+    HdDirtyBits* dirtyBits) {
     const auto& id = GetId();
+    // Meshes are synced in parallel, so the data is translated here and the
+    // writes to the Arnold nodes are staged.
+    auto* mesh = _mesh;
 
     if (HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->points)) {
-        param->End();
-        constexpr size_t maxSamples = 2;
-        HdTimeSampleArray<VtValue, maxSamples> xf;
-        delegate->SamplePrimvar(id, HdTokens->points, &xf);
-        if (xf.count > 0 &&
-            ARCH_LIKELY(xf.values[0].IsHolding<VtVec3fArray>())) {
-            const auto& v0 = xf.values[0].Get<VtVec3fArray>();
-            if (xf.count > 1 &&
-                ARCH_UNLIKELY(!xf.values[1].IsHolding<VtVec3fArray>())) {
-                xf.count = 1;
-            }
-            auto* arr = AiArrayAllocate(v0.size(), xf.count, AI_TYPE_VECTOR);
-            AiArraySetKey(arr, 0, v0.data());
-            if (xf.count > 1) {
-                const auto& v1 = xf.values[1].Get<VtVec3fArray>();
-                if (ARCH_LIKELY(v1.size() == v0.size())) {
-                    AiArraySetKey(arr, 1, v1.data());
-                } else {
-                    AiArraySetKey(arr, 1, v0.data());
+        auto* vlist = HdAiSampleDeformationKeys(
+            delegate, id, HdTokens->points, _pointSamples);
+        if (vlist != nullptr) {
+            _pointsHash = _HashArray(vlist, 0);
+            _staticPoints = AiArrayGetNumKeys(vlist) == 1;
+            param->Stage([mesh, vlist]() {
+                AiNodeSetArray(mesh, Str::vlist, vlist);
+                HdAiSetMotionRange(mesh);
+                // The number of keys might have changed without the normals
+                // being dirty.
+                const auto* nlist = AiNodeGetArray(mesh, Str::nlist);
+                if (nlist != nullptr && AiArrayGetNumElements(nlist) > 0 &&
+                    AiArrayGetNumKeys(nlist) != AiArrayGetNumKeys(vlist)) {
+                    _SetNormals(
+                        mesh, AiArrayCopy(nlist),
+                        AiArrayCopy(AiNodeGetArray(mesh, Str::nidxs)));
                 }
-            }
-            AiNodeSetArray(_mesh, Str::vlist, arr);
+            });
         }
     }
 
+    auto visibilityChanged = false;
     if (HdChangeTracker::IsVisibilityDirty(*dirtyBits, id)) {
         _UpdateVisibility(delegate, dirtyBits);
-        AiNodeSetByte(
-            _mesh, Str::visibility,
-            _sharedData.visible ? AI_RAY_ALL : uint8_t(0));
+        visibilityChanged = true;
+    }
+    const uint8_t visibility = _sharedData.visible ? AI_RAY_ALL : uint8_t(0);
+
+    const auto& instancerId = GetInstancerId();
+    if (instancerId.IsEmpty()) {
+        if (visibilityChanged) {
+            param->Stage([this, visibility]() {
+                // The polymesh stays hidden while it's shared, and until its
+                // geometry is pulled again after leaving the group.
+                if (_sharedInstance != nullptr) {
+                    AiNodeSetByte(_sharedInstance, Str::visibility, visibility);
+                } else if (!_geometryReleased) {
+                    AiNodeSetByte(_mesh, Str::visibility, visibility);
+                }
+            });
+        }
+    } else if (
+        visibilityChanged ||
+        HdChangeTracker::IsInstancerDirty(*dirtyBits, id) ||
+        HdChangeTracker::IsInstanceIndexDirty(*dirtyBits, id)) {
+        auto* instancer = dynamic_cast<HdAiInstancer*>(
+            delegate->GetRenderIndex().GetInstancer(instancerId));
+        if (instancer != nullptr) {
+            param->Stage([this, instancer, visibility]() {
+                // Only the ginstance nodes are rendered, the mesh is their
+                // source.
+                AiNodeSetByte(_mesh, Str::visibility, 0);
+                instancer->SyncInstances(
+                    _mesh, GetId(), visibility, _instances);
+            });
+        }
+    }
+
+    if (*dirtyBits & HdChangeTracker::DirtyCategories) {
+        const auto categories = delegate->GetCategories(id);
+        param->Stage([this, categories]() {
+            auto& lightLinking = _delegate->GetLightLinking();
+            lightLinking.SetShape(
+                _sharedInstance != nullptr ? _sharedInstance : _mesh,
+                categories);
+            lightLinking.SetInstances(_mesh, _instances);
+        });
     }
 
     if (HdChangeTracker::IsTopologyDirty(*dirtyBits, id)) {
-        param->End();
         const auto topology = GetMeshTopology(delegate);
-        const auto& vertexCounts = topology.GetFaceVertexCounts();
-        const auto& vertexIndices = topology.GetFaceVertexIndices();
-        const auto numFaces = topology.GetNumFaces();
-        const auto numVertexIndices = vertexIndices.size();
-        auto* nsides = AiArrayAllocate(numFaces, 1, AI_TYPE_UINT);
-        auto* vidxs = AiArrayAllocate(vertexIndices.size(), 1, AI_TYPE_UINT);
-        for (auto i = decltype(numFaces){0}; i < numFaces; ++i) {
-            AiArraySetUInt(
-                nsides, i, static_cast<unsigned int>(vertexCounts[i]));
-        }
-        for (auto i = decltype(numVertexIndices){0}; i < numVertexIndices;
-             ++i) {
-            AiArraySetUInt(
-                vidxs, i, static_cast<unsigned int>(vertexIndices[i]));
-        }
-        AiNodeSetArray(_mesh, Str::nsides, nsides);
-        AiNodeSetArray(_mesh, Str::vidxs, vidxs);
+        auto* nsides = HdAiConvertIndices(topology.GetFaceVertexCounts());
+        auto* vidxs = HdAiConvertIndices(topology.GetFaceVertexIndices());
         const auto scheme = topology.GetScheme();
-        if (scheme == PxOsdOpenSubdivTokens->catmullClark ||
-            scheme == PxOsdOpenSubdivTokens->catmark) {
-            AiNodeSetStr(_mesh, Str::subdiv_type, Str::catclark);
-        } else {
-            AiNodeSetStr(_mesh, Str::subdiv_type, Str::none);
-        }
+        const auto subdivType =
+            (scheme == PxOsdOpenSubdivTokens->catmullClark ||
+             scheme == PxOsdOpenSubdivTokens->catmark)
+                ? Str::catclark
+                : Str::none;
+        _topologyHash = _HashArray(
+            vidxs, _HashArray(nsides, subdivType == Str::catclark ? 1 : 2));
+        param->Stage([mesh, nsides, vidxs, subdivType]() {
+            AiNodeSetArray(mesh, Str::nsides, nsides);
+            AiNodeSetArray(mesh, Str::vidxs, vidxs);
+            AiNodeSetStr(mesh, Str::subdiv_type, subdivType);
+        });
     }
 
     if (HdChangeTracker::IsDisplayStyleDirty(*dirtyBits, id)) {
         const auto displayStyle = GetDisplayStyle(delegate);
-        AiNodeSetByte(
-            _mesh, Str::subdiv_iterations,
-            static_cast<uint8_t>(std::max(0, displayStyle.refineLevel)));
+        const auto subdivIterations =
+            static_cast<uint8_t>(std::max(0, displayStyle.refineLevel));
+        _subdivHash = static_cast<size_t>(subdivIterations) + 1;
+        param->Stage([mesh, subdivIterations]() {
+            AiNodeSetByte(mesh, Str::subdiv_iterations, subdivIterations);
+        });
     }
 
     if (HdChangeTracker::IsTransformDirty(*dirtyBits, id)) {
-        param->End();
-        HdAiSetTransform(_mesh, delegate, GetId());
+        auto* matrices = HdAiSampleTransform(delegate, id);
+        param->Stage([mesh, matrices]() {
+            AiNodeSetArray(mesh, Str::matrix, matrices);
+        });
     }
 
     if (HdChangeTracker::IsSubdivTagsDirty(*dirtyBits, id)) {
@@ -163,113 +348,322 @@ void HdAiMesh::Sync(
         auto* creaseSharpness =
             AiArrayAllocate(craseSharpnessCount, 1, AI_TYPE_FLOAT);
 
-        uint32_t ii = 0;
-        for (auto cornerIndex : cornerIndices) {
-            AiArraySetUInt(creaseIdxs, ii * 2, cornerIndex);
-            AiArraySetUInt(creaseIdxs, ii * 2 + 1, cornerIndex);
-            AiArraySetFlt(creaseSharpness, ii, cornerWeights[ii]);
-            ++ii;
-        }
+        if (craseSharpnessCount > 0) {
+            auto* idxs = static_cast<uint32_t*>(AiArrayMap(creaseIdxs));
+            auto* sharpness = static_cast<float*>(AiArrayMap(creaseSharpness));
+            uint32_t ii = 0;
+            for (auto cornerIndex : cornerIndices) {
+                idxs[ii * 2] = cornerIndex;
+                idxs[ii * 2 + 1] = cornerIndex;
+                sharpness[ii] = cornerWeights[ii];
+                ++ii;
+            }
 
-        uint32_t jj = 0;
-        for (auto creaseLength : creaseLengths) {
-            for (auto k = decltype(creaseLength){1}; k < creaseLength;
-                 ++k, ++ii) {
-                AiArraySetUInt(creaseIdxs, ii * 2, creaseIndices[jj + k - 1]);
-                AiArraySetUInt(creaseIdxs, ii * 2 + 1, creaseIndices[jj + k]);
-                AiArraySetFlt(creaseSharpness, ii, creaseWeights[jj]);
+            uint32_t jj = 0;
+            for (auto creaseLength : creaseLengths) {
+                for (auto k = decltype(creaseLength){1}; k < creaseLength;
+                     ++k, ++ii) {
+                    idxs[ii * 2] = creaseIndices[jj + k - 1];
+                    idxs[ii * 2 + 1] = creaseIndices[jj + k];
+                    sharpness[ii] = creaseWeights[jj];
+                }
+                jj += creaseLength;
             }
-            jj += creaseLength;
+            AiArrayUnmap(creaseIdxs);
+            AiArrayUnmap(creaseSharpness);
         }
 
-        AiNodeSetArray(_mesh, Str::crease_idxs, creaseIdxs);
-        AiNodeSetArray(_mesh, Str::crease_sharpness, creaseSharpness);
+        _creaseHash = _HashArray(creaseSharpness, _HashArray(creaseIdxs, 0));
+        param->Stage([mesh, creaseIdxs, creaseSharpness]() {
+            AiNodeSetArray(mesh, Str::crease_idxs, creaseIdxs);
+            AiNodeSetArray(mesh, Str::crease_sharpness, creaseSharpness);
+        });
     }
 
     if (*dirtyBits & HdChangeTracker::DirtyMaterialId) {
-        param->End();
+        const auto materialId = delegate->GetMaterialId(id);
+        param->Stage([this, materialId]() {
+            _delegate->GetMaterialBindings().Bind(GetId(), materialId);
+        });
         const auto* material = reinterpret_cast<const HdAiMaterial*>(
             delegate->GetRenderIndex().GetSprim(
-                HdPrimTypeTokens->material, delegate->GetMaterialId(id)));
+                HdPrimTypeTokens->material, materialId));
         if (material != nullptr) {
-            AiNodeSetPtr(_mesh, Str::shader, material->GetSurfaceShader());
-            AiNodeSetPtr(
-                _mesh, Str::disp_map, material->GetDisplacementShader());
-            // TODO: We need a way to detect this.
-            AiNodeSetBool(_mesh, Str::opaque, false);
+            auto* surface = material->GetSurfaceShader();
+            auto* displacement = material->GetDisplacementShader();
+            const AtNode* shaders[] = {surface, displacement};
+            _materialHash = static_cast<size_t>(ArchHash64(
+                reinterpret_cast<const char*>(shaders), sizeof(shaders)));
+            param->Stage([mesh, surface, displacement]() {
+                AiNodeSetPtr(mesh, Str::shader, surface);
+                AiNodeSetPtr(mesh, Str::disp_map, displacement);
+                // TODO: We need a way to detect this.
+                AiNodeSetBool(mesh, Str::opaque, false);
+            });
         } else {
-            AiNodeSetPtr(_mesh, Str::shader, _delegate->GetFallbackShader());
-            AiNodeSetPtr(_mesh, Str::disp_map, nullptr);
+            auto* fallback = _delegate->GetFallbackShader();
+            _materialHash = static_cast<size_t>(ArchHash64(
+                reinterpret_cast<const char*>(&fallback), sizeof(fallback)));
+            param->Stage([mesh, fallback]() {
+                AiNodeSetPtr(mesh, Str::shader, fallback);
+                AiNodeSetPtr(mesh, Str::disp_map, nullptr);
+            });
         }
     }
 
     // TODO: Implement all the primvars.
-    if (*dirtyBits & HdChangeTracker::DirtyPrimvar) {
-        param->End();
-        for (const auto& primvar : delegate->GetPrimvarDescriptors(
-                 id, HdInterpolation::HdInterpolationConstant)) {
-            HdAiSetConstantPrimvar(_mesh, id, delegate, primvar);
+    // Hydra only flags that some primvar changed, so the values are compared
+    // against the hashes of the last sync, and only the changed primvars are
+    // written. The arrays of the other ones are kept on the node. Changing the
+    // topology invalidates all of them.
+    const auto topologyDirty = HdChangeTracker::IsTopologyDirty(*dirtyBits, id);
+    if (topologyDirty) { _primvarHashes.clear(); }
+    if (topologyDirty || (*dirtyBits & HdChangeTracker::DirtyPrimvar)) {
+        decltype(_primvarHashes) primvarHashes;
+        std::vector<TfToken> removedPrimvars;
+        auto hasUVs = false;
+        auto hasNormals = false;
+        auto hasPrimvars = false;
+        std::vector<_Primvar> primvars;
+        std::vector<_IndexedPrimvar> indexedPrimvars;
+        AtArray* uvlist = nullptr;
+        AtArray* uvidxs = nullptr;
+        AtArray* nlist = nullptr;
+        AtArray* nidxs = nullptr;
+        const auto weldFaceVarying =
+            HdAiConfig::GetInstance().weld_face_varying;
+        for (const auto interpolation :
+             {HdInterpolationConstant, HdInterpolationUniform,
+              HdInterpolationVertex, HdInterpolationFaceVarying}) {
+            for (const auto& primvar :
+                 delegate->GetPrimvarDescriptors(id, interpolation)) {
+                if (primvar.name == HdTokens->points) { continue; }
+                auto value = delegate->Get(id, primvar.name);
+                const auto isUV =
+                    (interpolation == HdInterpolationVertex ||
+                     interpolation == HdInterpolationFaceVarying) &&
+                    (primvar.name == _tokens->st ||
+                     primvar.name == _tokens->uv) &&
+                    value.IsHolding<VtArray<GfVec2f>>();
+                const auto isNormal =
+                    (interpolation == HdInterpolationVertex ||
+                     interpolation == HdInterpolationFaceVarying) &&
+                    primvar.name == HdTokens->normals &&
+                    value.IsHolding<VtArray<GfVec3f>>();
+                hasUVs = hasUVs || isUV;
+                hasNormals = hasNormals || isNormal;
+                hasPrimvars = hasPrimvars || (!isUV && !isNormal);
+                const auto hash =
+                    _HashPrimvar(value, primvar.role, interpolation);
+                primvarHashes[primvar.name] = hash;
+                const auto cached = _primvarHashes.find(primvar.name);
+                if (cached != _primvarHashes.end() && cached->second == hash) {
+                    continue;
+                }
+                // Animated face-varying data would be welded on every
+                // sync, so it's only welded the first time.
+                const auto weld = weldFaceVarying &&
+                                  interpolation == HdInterpolationFaceVarying &&
+                                  cached == _primvarHashes.end();
+                if (isUV) {
+                    if (uvlist != nullptr) { AiArrayDestroy(uvlist); }
+                    if (uvidxs != nullptr) { AiArrayDestroy(uvidxs); }
+                    // Vertex uvs share the vertex indices, which are only
+                    // available on the node.
+                    if (interpolation == HdInterpolationFaceVarying) {
+                        _ConvertFaceVarying<GfVec2f>(
+                            value, AI_TYPE_VECTOR2, weld, param->GetStats(),
+                            uvlist, uvidxs);
+                    } else {
+                        const auto& uv =
+                            value.UncheckedGet<VtArray<GfVec2f>>();
+                        uvlist = AiArrayConvert(
+                            static_cast<unsigned int>(uv.size()), 1,
+                            AI_TYPE_VECTOR2, uv.data());
+                        uvidxs = nullptr;
+                    }
+                    _uvHash = _HashArray(
+                        uvidxs, _HashArray(uvlist, uvidxs == nullptr ? 1 : 2));
+                } else if (isNormal) {
+                    // Authored normals go to the native arrays, so they are
+                    // used for shading instead of being plain user data.
+                    if (nlist != nullptr) { AiArrayDestroy(nlist); }
+                    if (nidxs != nullptr) { AiArrayDestroy(nidxs); }
+                    if (interpolation == HdInterpolationFaceVarying) {
+                        _ConvertFaceVarying<GfVec3f>(
+                            value, AI_TYPE_VECTOR, weld, param->GetStats(),
+                            nlist, nidxs);
+                    } else {
+                        const auto& normals =
+                            value.UncheckedGet<VtArray<GfVec3f>>();
+                        nlist = AiArrayConvert(
+                            static_cast<unsigned int>(normals.size()), 1,
+                            AI_TYPE_VECTOR, normals.data());
+                        nidxs = nullptr;
+                    }
+                    _normalHash = _HashArray(
+                        nidxs, _HashArray(nlist, nidxs == nullptr ? 1 : 2));
+                } else if (weld) {
+                    // Welding on the sync thread keeps the staged write cheap,
+                    // and the data stays indexed on the node.
+                    _IndexedPrimvar indexed{
+                        primvar.name, TfToken(), nullptr, nullptr};
+                    const auto start = HdAiRenderStats::Clock::now();
+                    const auto welded = HdAiWeldFaceVarying(
+                        value, primvar.role == HdPrimvarRoleTokens->color,
+                        indexed.type, indexed.values, indexed.indices);
+                    param->GetStats().AddWeldTime(start);
+                    if (welded) {
+                        indexedPrimvars.push_back(indexed);
+                    } else {
+                        primvars.push_back(
+                            {primvar.name, primvar.role, interpolation,
+                             std::move(value)});
+                    }
+                } else {
+                    primvars.push_back(
+                        {primvar.name, primvar.role, interpolation,
+                         std::move(value)});
+                }
+            }
         }
-        for (const auto& primvar : delegate->GetPrimvarDescriptors(
-                 id, HdInterpolation::HdInterpolationUniform)) {
-            HdAiSetUniformPrimvar(_mesh, id, delegate, primvar);
+        // Removed uvs and normals are not user parameters, so the lookup
+        // skips them and their native arrays are reset instead.
+        for (const auto& cached : _primvarHashes) {
+            if (primvarHashes.find(cached.first) == primvarHashes.end()) {
+                removedPrimvars.push_back(cached.first);
+            }
         }
-        for (const auto& primvar : delegate->GetPrimvarDescriptors(
-                 id, HdInterpolation::HdInterpolationVertex)) {
-            if (primvar.name == HdTokens->points) {
-                continue;
-            } else if (
-                primvar.name == _tokens->st || primvar.name == _tokens->uv) {
-                const auto v = delegate->Get(id, primvar.name);
-                if (v.IsHolding<VtArray<GfVec2f>>()) {
-                    const auto& uv = v.UncheckedGet<VtArray<GfVec2f>>();
-                    const auto numUVs = static_cast<unsigned int>(uv.size());
-                    // Can assume uvs are flattened, with indices matching
-                    // vert indices
-                    auto* uvlist =
-                        AiArrayConvert(numUVs, 1, AI_TYPE_VECTOR2, uv.data());
-                    auto* uvidxs =
-                        AiArrayCopy(AiNodeGetArray(_mesh, Str::vidxs));
-
-                    AiNodeSetArray(_mesh, Str::uvlist, uvlist);
-                    AiNodeSetArray(_mesh, Str::uvidxs, uvidxs);
+        _primvarHashes.swap(primvarHashes);
+        const auto resetUVs = !hasUVs && _uvHash != 0;
+        const auto resetNormals = !hasNormals && _normalHash != 0;
+        if (!hasUVs) { _uvHash = 0; }
+        if (!hasNormals) { _normalHash = 0; }
+        _hasPrimvars = hasPrimvars;
+        param->Stage([mesh, uvlist, uvidxs, nlist, nidxs, primvars,
+                      indexedPrimvars, removedPrimvars, resetUVs,
+                      resetNormals]() {
+            for (const auto& name : removedPrimvars) {
+                if (AiNodeLookUpUserParameter(mesh, name.GetText()) !=
+                    nullptr) {
+                    AiNodeResetParameter(mesh, name.GetText());
                 }
-
-            } else {
-                HdAiSetVertexPrimvar(_mesh, id, delegate, primvar);
             }
-        }
-        for (const auto& primvar : delegate->GetPrimvarDescriptors(
-                 id, HdInterpolation::HdInterpolationFaceVarying)) {
-            if (primvar.name == _tokens->st || primvar.name == _tokens->uv) {
-                const auto v = delegate->Get(id, primvar.name);
-                if (v.IsHolding<VtArray<GfVec2f>>()) {
-                    const auto& uv = v.UncheckedGet<VtArray<GfVec2f>>();
-                    const auto numUVs = static_cast<unsigned int>(uv.size());
-                    // Same memory layout and this data is flattened.
-                    auto* uvlist =
-                        AiArrayConvert(numUVs, 1, AI_TYPE_VECTOR2, uv.data());
-                    auto* uvidxs = AiArrayAllocate(numUVs, 1, AI_TYPE_UINT);
-                    for (auto i = decltype(numUVs){0}; i < numUVs; ++i) {
-                        AiArraySetUInt(uvidxs, i, i);
-                    }
-                    AiNodeSetArray(_mesh, Str::uvlist, uvlist);
-                    AiNodeSetArray(_mesh, Str::uvidxs, uvidxs);
+            if (resetUVs) {
+                AiNodeResetParameter(mesh, Str::uvlist.c_str());
+                AiNodeResetParameter(mesh, Str::uvidxs.c_str());
+            }
+            if (resetNormals) {
+                AiNodeResetParameter(mesh, Str::nlist.c_str());
+                AiNodeResetParameter(mesh, Str::nidxs.c_str());
+            }
+            for (const auto& primvar : primvars) {
+                if (primvar.interpolation == HdInterpolationConstant) {
+                    HdAiSetConstantPrimvar(
+                        mesh, primvar.name, primvar.role, primvar.value);
+                } else if (primvar.interpolation == HdInterpolationUniform) {
+                    HdAiSetUniformPrimvar(
+                        mesh, primvar.name, primvar.role, primvar.value);
+                } else if (primvar.interpolation == HdInterpolationVertex) {
+                    HdAiSetVertexPrimvar(
+                        mesh, primvar.name, primvar.role, primvar.value);
+                } else {
+                    HdAiSetFaceVaryingPrimvar(
+                        mesh, primvar.name, primvar.role, primvar.value);
                 }
-            } else {
-                HdAiSetFaceVaryingPrimvar(_mesh, id, delegate, primvar);
             }
-        }
+            if (uvlist != nullptr) {
+                AiNodeSetArray(mesh, Str::uvlist, uvlist);
+                AiNodeSetArray(
+                    mesh, Str::uvidxs,
+                    uvidxs != nullptr
+                        ? uvidxs
+                        : AiArrayCopy(AiNodeGetArray(mesh, Str::vidxs)));
+            }
+            for (const auto& primvar : indexedPrimvars) {
+                HdAiSetIndexedPrimvar(
+                    mesh, primvar.name, primvar.type, primvar.values,
+                    primvar.indices);
+            }
+            if (nlist != nullptr) { _SetNormals(mesh, nlist, nidxs); }
+        });
     }
+}
 
-    *dirtyBits = HdChangeTracker::Clean;
+bool HdAiMesh::_IsShareable() const {
+    // Only static meshes without user data are shared, the other ones would
+    // rarely match.
+    return HdAiConfig::GetInstance().deduplicate_meshes &&
+           GetInstancerId().IsEmpty() && _staticPoints && !_hasPrimvars;
+}
+
+size_t HdAiMesh::_GetGeometryHash() const {
+    const size_t hashes[] = {_pointsHash, _topologyHash, _subdivHash,
+                             _creaseHash, _uvHash,      _normalHash,
+                             _materialHash};
+    return static_cast<size_t>(ArchHash64(
+        reinterpret_cast<const char*>(hashes), sizeof(hashes)));
+}
+
+void HdAiMesh::UseSharedGeometry(AtNode* shared) {
+    if (_sharedInstance == nullptr) {
+        _sharedInstance = AiNode(_delegate->GetUniverse(), Str::ginstance);
+        AiNodeSetStr(
+            _sharedInstance, Str::name,
+            TfStringPrintf("%s/__hdAiShared", GetId().GetText()).c_str());
+        // The shared geometry has an identity matrix.
+        AiNodeSetBool(_sharedInstance, Str::inherit_xform, false);
+        _delegate->GetStats().NodeCreated();
+        _delegate->GetLightLinking().ReplaceShape(_mesh, _sharedInstance);
+    }
+    AiNodeSetPtr(_sharedInstance, Str::node, shared);
+    AiNodeSetArray(
+        _sharedInstance, Str::matrix,
+        AiArrayCopy(AiNodeGetArray(_mesh, Str::matrix)));
+    AiNodeSetByte(
+        _sharedInstance, Str::visibility,
+        _sharedData.visible ? AI_RAY_ALL : uint8_t(0));
+    AiNodeSetByte(_mesh, Str::visibility, 0);
+    HdAiGeometryRegistry::ReleaseGeometry(_mesh);
+    _geometryReleased = true;
+}
+
+void HdAiMesh::_UpdateSharedGeometry(bool eligible, size_t hash) {
+    auto& registry = _delegate->GetGeometryRegistry();
+    const uint8_t visibility = _sharedData.visible ? AI_RAY_ALL : uint8_t(0);
+    if (_registered && (!eligible || hash != _registeredHash)) {
+        registry.Unregister(this, _registeredHash);
+        _registered = false;
+        if (_sharedInstance != nullptr) {
+            _delegate->GetLightLinking().ReplaceShape(_sharedInstance, _mesh);
+            AiNodeDestroy(_sharedInstance);
+            _delegate->GetStats().NodeDestroyed();
+            _sharedInstance = nullptr;
+        }
+        // The sync staging this write pulled the whole mesh again, if its
+        // geometry was released.
+        _geometryReleased = false;
+        AiNodeSetByte(_mesh, Str::visibility, visibility);
+    }
+    if (eligible && !_registered) {
+        _registered = true;
+        _registeredHash = hash;
+        registry.Register(this, _mesh, hash);
+    } else if (_sharedInstance != nullptr) {
+        AiNodeSetArray(
+            _sharedInstance, Str::matrix,
+            AiArrayCopy(AiNodeGetArray(_mesh, Str::matrix)));
+    }
 }
 
 HdDirtyBits HdAiMesh::GetInitialDirtyBitsMask() const {
     return HdChangeTracker::Clean | HdChangeTracker::InitRepr |
            HdChangeTracker::DirtyPoints | HdChangeTracker::DirtyTopology |
            HdChangeTracker::DirtyTransform | HdChangeTracker::DirtyMaterialId |
-           HdChangeTracker::DirtyPrimvar | HdChangeTracker::DirtyVisibility;
+           HdChangeTracker::DirtyPrimvar | HdChangeTracker::DirtyVisibility |
+           HdChangeTracker::DirtyInstancer |
+           HdChangeTracker::DirtyInstanceIndex |
+           HdChangeTracker::DirtyCategories;
 }
 
 HdDirtyBits HdAiMesh::_PropagateDirtyBits(HdDirtyBits bits) const {
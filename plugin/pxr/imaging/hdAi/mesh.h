@@ -17,12 +17,16 @@
 #include <pxr/pxr.h>
 #include "pxr/imaging/hdAi/api.h"
 
+#include <pxr/base/tf/hashmap.h>
 #include <pxr/imaging/hd/mesh.h>
 
 #include "pxr/imaging/hdAi/renderDelegate.h"
+#include "pxr/imaging/hdAi/utils.h"
 
 #include <ai.h>
 
+#include <vector>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 class HdAiMesh : public HdMesh {
@@ -43,6 +47,11 @@ public:
     HDAI_API
     HdDirtyBits GetInitialDirtyBitsMask() const override;
 
+    /// Renders the mesh through a ginstance of \p shared, which holds the
+    /// same geometry, and releases the geometry of the mesh's polymesh.
+    HDAI_API
+    void UseSharedGeometry(AtNode* shared);
+
 protected:
     HDAI_API
     HdDirtyBits _PropagateDirtyBits(HdDirtyBits bits) const override;
@@ -50,8 +59,43 @@ protected:
     HDAI_API
     void _InitRepr(const TfToken& reprToken, HdDirtyBits* dirtyBits) override;
 
+    /// Translates the dirty parts of the mesh and stages their writes.
+    void _Translate(
+        HdSceneDelegate* delegate, HdAiRenderParam* param,
+        HdDirtyBits* dirtyBits);
+
+    /// Returns true if the mesh can share its geometry with other meshes.
+    bool _IsShareable() const;
+
+    /// Returns the hash of the translated geometry and material.
+    size_t _GetGeometryHash() const;
+
+    /// Registers the mesh in the geometry registry if it's eligible for
+    /// sharing its geometry, and updates the ginstance of the shared geometry.
+    void _UpdateSharedGeometry(bool eligible, size_t hash);
+
     HdAiRenderDelegate* _delegate;
     AtNode* _mesh;
+    HdAiMotionSamples _pointSamples;
+    /// ginstance nodes of the mesh, when it's a prototype of an instancer.
+    std::vector<AtNode*> _instances;
+    /// ginstance of the shared geometry, when the mesh is deduplicated.
+    AtNode* _sharedInstance = nullptr;
+    // Hashes of the parts of the translated geometry.
+    size_t _pointsHash = 0;
+    size_t _topologyHash = 0;
+    size_t _subdivHash = 0;
+    size_t _creaseHash = 0;
+    size_t _uvHash = 0;
+    size_t _normalHash = 0;
+    size_t _materialHash = 0;
+    size_t _registeredHash = 0;
+    /// Hashes of the primvars written to the polymesh, by name.
+    TfHashMap<TfToken, size_t, TfToken::HashFunctor> _primvarHashes;
+    bool _staticPoints = false;
+    bool _hasPrimvars = false;
+    bool _registered = false;
+    bool _geometryReleased = false;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
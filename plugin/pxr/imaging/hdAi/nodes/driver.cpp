@@ -13,9 +13,18 @@
 // limitations under the License.
 #include <ai.h>
 
+#include <pxr/base/gf/half.h>
+
 #include <tbb/concurrent_queue.h>
 
+#include <algorithm>
+#include <cstring> // memcpy
 #include <memory>
+#include <thread>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
 
 #include "pxr/imaging/hdAi/nodes/nodes.h"
 #include "pxr/imaging/hdAi/utils.h"
@@ -25,28 +34,181 @@ PXR_NAMESPACE_USING_DIRECTIVE
 AI_DRIVER_NODE_EXPORT_METHODS(HdAiDriverMtd);
 
 AtString HdAiDriver::projMtx("projMtx");
-AtString HdAiDriver::viewMtx("viewMtx");
+AtString HdAiDriver::beautyFormat("beautyFormat");
+AtString HdAiDriver::bucketQueue("bucketQueue");
 
 namespace {
 const char* supportedExtensions[] = {nullptr};
 
 struct DriverData {
-    // I think we just uncovered a bug in Arnold.
-    // This fails with AtMatrix, looks like as if the [3][3] of the proj
-    // matrix is used incorrectly.
-    GfMatrix4f projMtx;
-    GfMatrix4f viewMtx;
+    HdAiDepthConversion depthConversion;
+    HdAiBeautyFormat beautyFormat = HdAiBeautyFormat::UNorm8;
+    HdAiBucketQueue* bucketQueue = nullptr;
 };
+
+void _QuantizeBucketUNorm8(
+    const AtRGBA* in, AtRGBA8* out, int bucketXO, int bucketYO,
+    int bucketSizeX, int bucketSizeY) {
+    for (auto y = 0; y < bucketSizeY; ++y) {
+        for (auto x = 0; x < bucketSizeX; ++x, ++in, ++out) {
+            const auto px = bucketXO + x;
+            const auto py = bucketYO + y;
+            out->r = AiQuantize8bit(px, py, 0, in->r, true);
+            out->g = AiQuantize8bit(px, py, 1, in->g, true);
+            out->b = AiQuantize8bit(px, py, 2, in->b, true);
+            out->a = AiQuantize8bit(px, py, 3, in->a, true);
+        }
+    }
+}
+
+// AtRGBA is four tightly packed floats, so the full precision path is a
+// straight copy.
+void _ConvertBucketFloat32(const AtRGBA* in, uint8_t* out, size_t numPixels) {
+    memcpy(out, in, numPixels * sizeof(AtRGBA));
+}
+
+void _ConvertBucketFloat16(const AtRGBA* in, uint8_t* out, size_t numPixels) {
+    const auto* src = reinterpret_cast<const float*>(in);
+    auto* dst = reinterpret_cast<GfHalf*>(out);
+    const auto numValues = numPixels * 4;
+    size_t i = 0;
+#ifdef __F16C__
+    // Two pixels per iteration.
+    for (; i + 8 <= numValues; i += 8) {
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i*>(dst + i),
+            _mm256_cvtps_ph(
+                _mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+#endif
+    for (; i < numValues; ++i) { dst[i] = GfHalf(src[i]); }
+}
+
 } // namespace
 
-tbb::concurrent_queue<HdAiBucketData*> bucketQueue;
+void hdAiConvertBeautyBucket(
+    const AtRGBA* in, uint8_t* out, HdAiBeautyFormat format, int xo, int yo,
+    int sizeX, int sizeY) {
+    const auto numPixels = static_cast<size_t>(sizeX) * sizeY;
+    if (format == HdAiBeautyFormat::Float32) {
+        _ConvertBucketFloat32(in, out, numPixels);
+    } else if (format == HdAiBeautyFormat::Float16) {
+        _ConvertBucketFloat16(in, out, numPixels);
+    } else {
+        _QuantizeBucketUNorm8(
+            in, reinterpret_cast<AtRGBA8*>(out), xo, yo, sizeX, sizeY);
+    }
+}
+
+// The Z AOV is the positive depth along the view direction, so the view space
+// position is (x, y, -Z). Only the third and fourth columns of the projection
+// matrix affect the depth, which leaves a single fused expression per pixel:
+//   ndc = (-Z * proj[2][2] + proj[3][2]) / (-Z * proj[2][3] + proj[3][3])
+void hdAiConvertDepthRow(
+    const HdAiDepthConversion& conversion, const float* in, float* out,
+    int count) {
+    const auto a = conversion.a;
+    const auto b = conversion.b;
+    const auto c = conversion.c;
+    const auto d = conversion.d;
+    for (auto i = 0; i < count; ++i) {
+        const auto z = in[i];
+        out[i] = std::max(-1.0f, std::min(1.0f, (a * z + b) / (c * z + d)));
+    }
+}
+
+HdAiBucketArena::~HdAiBucketArena() {
+    HdAiBucketData* data = nullptr;
+    while (_freeList.try_pop(data)) { delete data; }
+}
 
-void hdAiEmptyBucketQueue(const std::function<void(const HdAiBucketData*)>& f) {
+void HdAiBucketArena::Reserve(int width, int height, int bucketSize) {
     HdAiBucketData* data = nullptr;
-    while (bucketQueue.try_pop(data)) {
+    while (_freeList.try_pop(data)) {
+        _reservedBytes.fetch_sub(
+            data->beauty.capacity() + data->depth.capacity() * sizeof(float));
+        delete data;
+    }
+    bucketSize = std::max(1, bucketSize);
+    const auto bucketPixels = static_cast<size_t>(bucketSize * bucketSize);
+    _bucketPixels.store(bucketPixels);
+    // There are rarely more buckets waiting to be drawn than twice the number
+    // of threads, the arena grows past that if needed.
+    const auto bucketsPerFrame =
+        static_cast<size_t>((width + bucketSize - 1) / bucketSize) *
+        static_cast<size_t>((height + bucketSize - 1) / bucketSize);
+    const auto numBuckets = std::min(
+        bucketsPerFrame,
+        static_cast<size_t>(
+            std::max(1u, std::thread::hardware_concurrency()) * 2));
+    for (auto i = decltype(numBuckets){0}; i < numBuckets; ++i) {
+        _freeList.push(_Allocate(bucketPixels));
+    }
+}
+
+HdAiBucketData* HdAiBucketArena::Acquire(size_t numPixels) {
+    HdAiBucketData* data = nullptr;
+    if (_freeList.try_pop(data)) {
+        _numReuses.fetch_add(1);
+        const auto reserved =
+            data->beauty.capacity() + data->depth.capacity() * sizeof(float);
+        data->beauty.reserve(numPixels * sizeof(AtRGBA));
+        data->depth.reserve(numPixels);
+        _reservedBytes.fetch_add(
+            data->beauty.capacity() + data->depth.capacity() * sizeof(float) -
+            reserved);
+    } else {
+        data = _Allocate(std::max(numPixels, _bucketPixels.load()));
+    }
+    const auto numInUse = _numInUse.fetch_add(1) + 1;
+    auto peakInUse = _peakInUse.load();
+    while (numInUse > peakInUse &&
+           !_peakInUse.compare_exchange_weak(peakInUse, numInUse)) {}
+    return data;
+}
+
+void HdAiBucketArena::Release(HdAiBucketData* data) {
+    if (data == nullptr) { return; }
+    data->beauty.clear();
+    data->depth.clear();
+    _numInUse.fetch_sub(1);
+    _freeList.push(data);
+}
+
+HdAiBucketArenaStats HdAiBucketArena::GetStats() const {
+    HdAiBucketArenaStats stats;
+    stats.numAllocations = _numAllocations.load();
+    stats.numReuses = _numReuses.load();
+    stats.numInUse = _numInUse.load();
+    stats.peakInUse = _peakInUse.load();
+    stats.reservedBytes = _reservedBytes.load();
+    return stats;
+}
+
+HdAiBucketData* HdAiBucketArena::_Allocate(size_t numPixels) {
+    auto* data = new HdAiBucketData();
+    // The largest pixel format is AtRGBA.
+    data->beauty.reserve(numPixels * sizeof(AtRGBA));
+    data->depth.reserve(numPixels);
+    _numAllocations.fetch_add(1);
+    _reservedBytes.fetch_add(
+        data->beauty.capacity() + data->depth.capacity() * sizeof(float));
+    return data;
+}
+
+HdAiBucketQueue::~HdAiBucketQueue() {
+    Empty([](const HdAiBucketData*) {});
+}
+
+void HdAiBucketQueue::Push(HdAiBucketData* data) { _queue.push(data); }
+
+void HdAiBucketQueue::Empty(
+    const std::function<void(const HdAiBucketData*)>& f) {
+    HdAiBucketData* data = nullptr;
+    while (_queue.try_pop(data)) {
         if (data) {
             f(data);
-            delete data;
+            _arena.Release(data);
             data = nullptr;
         }
     }
@@ -54,7 +216,9 @@ void hdAiEmptyBucketQueue(const std::function<void(const HdAiBucketData*)>& f) {
 
 node_parameters {
     AiParameterMtx(HdAiDriver::projMtx, AiM4Identity());
-    AiParameterMtx(HdAiDriver::viewMtx, AiM4Identity());
+    AiParameterInt(
+        HdAiDriver::beautyFormat, static_cast<int>(HdAiBeautyFormat::UNorm8));
+    AiParameterPtr(HdAiDriver::bucketQueue, nullptr);
 }
 
 node_initialize {
@@ -66,16 +230,29 @@ node_initialize {
 
 node_update {
     auto* data = reinterpret_cast<DriverData*>(AiNodeGetLocalData(node));
-    data->projMtx =
+    const auto projMtx =
         HdAiConvertMatrix(AiNodeGetMatrix(node, HdAiDriver::projMtx));
-    data->viewMtx =
-        HdAiConvertMatrix(AiNodeGetMatrix(node, HdAiDriver::viewMtx));
+    data->depthConversion.a = -projMtx[2][2];
+    data->depthConversion.b = projMtx[3][2];
+    data->depthConversion.c = -projMtx[2][3];
+    data->depthConversion.d = projMtx[3][3];
+    const auto beautyFormat = AiNodeGetInt(node, HdAiDriver::beautyFormat);
+    data->beautyFormat =
+        beautyFormat == static_cast<int>(HdAiBeautyFormat::Float32)
+            ? HdAiBeautyFormat::Float32
+            : (beautyFormat == static_cast<int>(HdAiBeautyFormat::Float16)
+                   ? HdAiBeautyFormat::Float16
+                   : HdAiBeautyFormat::UNorm8);
+    data->bucketQueue = reinterpret_cast<HdAiBucketQueue*>(
+        AiNodeGetPtr(node, HdAiDriver::bucketQueue));
 }
 
-node_finish {}
+node_finish {
+    delete reinterpret_cast<DriverData*>(AiNodeGetLocalData(node));
+}
 
 driver_supports_pixel_type {
-    return pixel_type == AI_TYPE_RGBA || pixel_type == AI_TYPE_VECTOR;
+    return pixel_type == AI_TYPE_RGBA || pixel_type == AI_TYPE_FLOAT;
 }
 
 driver_extension { return supportedExtensions; }
@@ -89,52 +266,47 @@ driver_prepare_bucket {}
 driver_process_bucket {
     const auto* driverData =
         reinterpret_cast<const DriverData*>(AiNodeGetLocalData(node));
+    auto* bucketQueue = driverData->bucketQueue;
+    if (bucketQueue == nullptr) { return; }
     const char* outputName = nullptr;
     int pixelType = AI_TYPE_RGBA;
     const void* bucketData = nullptr;
-    auto* data = new HdAiBucketData();
+    const AtRGBA* inRGBA = nullptr;
+    const auto bucketSize = bucket_size_x * bucket_size_y;
+    auto& arena = bucketQueue->GetArena();
+    auto* data = arena.Acquire(bucketSize);
     data->xo = bucket_xo;
     data->yo = bucket_yo;
     data->sizeX = bucket_size_x;
     data->sizeY = bucket_size_y;
-    const auto bucketSize = bucket_size_x * bucket_size_y;
+    data->beautyFormat = driverData->beautyFormat;
     while (AiOutputIteratorGetNext(
         iterator, &outputName, &pixelType, &bucketData)) {
         if (pixelType == AI_TYPE_RGBA && strcmp(outputName, "RGBA") == 0) {
-            data->beauty.resize(bucketSize);
-            const auto* inRGBA = reinterpret_cast<const AtRGBA*>(bucketData);
-            for (auto i = decltype(bucketSize){0}; i < bucketSize; ++i) {
-                const auto in = inRGBA[i];
-                const auto x = bucket_xo + i % bucket_size_x;
-                const auto y = bucket_yo + i / bucket_size_x;
-                AtRGBA8 out;
-                out.r = AiQuantize8bit(x, y, 0, in.r, true);
-                out.g = AiQuantize8bit(x, y, 1, in.g, true);
-                out.b = AiQuantize8bit(x, y, 2, in.b, true);
-                out.a = AiQuantize8bit(x, y, 3, in.a, true);
-                data->beauty[i] = out;
-            }
-
-        } else if (
-            pixelType == AI_TYPE_VECTOR && strcmp(outputName, "P") == 0) {
-            data->depth.resize(bucketSize, 1.0f);
-            const auto* pp = reinterpret_cast<const GfVec3f*>(bucketData);
-            auto* pz = data->depth.data();
-            for (auto i = decltype(bucketSize){0}; i < bucketSize; ++i) {
-                // Rays hitting the background will return a (0,0,0) vector.
-                const auto p = driverData->projMtx.Transform(
-                    driverData->viewMtx.Transform(pp[i]));
-                pz[i] = std::max(-1.0f, std::min(1.0f, p[2]));
+            inRGBA = reinterpret_cast<const AtRGBA*>(bucketData);
+            data->beauty.resize(
+                bucketSize * hdAiGetBeautyPixelSize(data->beautyFormat));
+            hdAiConvertBeautyBucket(
+                inRGBA, data->beauty.data(), data->beautyFormat, bucket_xo,
+                bucket_yo, bucket_size_x, bucket_size_y);
+        } else if (pixelType == AI_TYPE_FLOAT && strcmp(outputName, "Z") == 0) {
+            data->depth.resize(bucketSize);
+            const auto* inZ = reinterpret_cast<const float*>(bucketData);
+            auto* outZ = data->depth.data();
+            for (auto y = 0; y < bucket_size_y; ++y) {
+                hdAiConvertDepthRow(
+                    driverData->depthConversion, inZ + y * bucket_size_x,
+                    outZ + y * bucket_size_x, bucket_size_x);
             }
         }
     }
-    if (data->beauty.empty() || data->depth.empty()) {
-        delete data;
+    if (inRGBA == nullptr || data->depth.empty()) {
+        arena.Release(data);
     } else {
         for (auto i = decltype(bucketSize){0}; i < bucketSize; ++i) {
-            if (data->beauty[i].a == 0) { data->depth[i] = 1.0f - AI_EPSILON; }
+            if (inRGBA[i].a <= 0.0f) { data->depth[i] = 1.0f - AI_EPSILON; }
         }
-        bucketQueue.push(data);
+        bucketQueue->Push(data);
     }
 }
 
@@ -14,8 +14,13 @@
 #ifndef HDAI_NODES_H
 #define HDAI_NODES_H
 
+#include "pxr/imaging/hdAi/api.h"
+
 #include <ai.h>
 
+#include <tbb/concurrent_queue.h>
+
+#include <atomic>
 #include <functional>
 #include <vector>
 
@@ -25,7 +30,8 @@ extern AtString driver;
 
 namespace HdAiDriver {
 extern AtString projMtx;
-extern AtString viewMtx;
+extern AtString beautyFormat;
+extern AtString bucketQueue;
 } // namespace HdAiDriver
 
 void hdAiInstallNodes();
@@ -38,6 +44,43 @@ struct AtRGBA8 {
     uint8_t a = 0;
 };
 
+/// Pixel formats the driver can store the beauty output in.
+enum class HdAiBeautyFormat : int {
+    UNorm8 = 0, ///< AtRGBA8, dithered and quantized by Arnold.
+    Float16,    ///< Four half floats, preserving HDR values.
+    Float32,    ///< AtRGBA, a direct copy of the Arnold output.
+};
+
+inline size_t hdAiGetBeautyPixelSize(HdAiBeautyFormat format) {
+    return format == HdAiBeautyFormat::Float32
+               ? sizeof(AtRGBA)
+               : (format == HdAiBeautyFormat::Float16 ? sizeof(uint16_t) * 4
+                                                      : sizeof(AtRGBA8));
+}
+
+/// Converts a bucket of Arnold RGBA pixels, starting at \p xo, \p yo, to
+/// \p format. \p out has to hold hdAiGetBeautyPixelSize(format) bytes per
+/// pixel.
+HDAI_API
+void hdAiConvertBeautyBucket(
+    const AtRGBA* in, uint8_t* out, HdAiBeautyFormat format, int xo, int yo,
+    int sizeX, int sizeY);
+
+/// Coefficients converting the camera space depth of the Z AOV to NDC depth,
+/// from the third and fourth columns of the projection matrix.
+struct HdAiDepthConversion {
+    float a = -1.0f;
+    float b = 0.0f;
+    float c = 0.0f;
+    float d = 1.0f;
+};
+
+/// Converts \p count Z values to NDC depth, clamped to [-1, 1].
+HDAI_API
+void hdAiConvertDepthRow(
+    const HdAiDepthConversion& conversion, const float* in, float* out,
+    int count);
+
 struct HdAiBucketData {
     HdAiBucketData() = default;
     ~HdAiBucketData() = default;
@@ -48,10 +91,80 @@ struct HdAiBucketData {
     int yo = 0;
     int sizeX = 0;
     int sizeY = 0;
-    std::vector<AtRGBA8> beauty;
+    HdAiBeautyFormat beautyFormat = HdAiBeautyFormat::UNorm8;
+    // Raw pixels in beautyFormat.
+    std::vector<uint8_t> beauty;
     std::vector<float> depth;
 };
 
-void hdAiEmptyBucketQueue(const std::function<void(const HdAiBucketData*)>& f);
+struct HdAiBucketArenaStats {
+    /// Number of buckets allocated on the heap.
+    size_t numAllocations = 0;
+    /// Number of buckets served from the free list.
+    size_t numReuses = 0;
+    /// Number of buckets currently held by the driver or the render pass.
+    size_t numInUse = 0;
+    /// Highest number of buckets held at the same time.
+    size_t peakInUse = 0;
+    /// Memory used by the pixel storage of all the allocated buckets.
+    size_t reservedBytes = 0;
+};
+
+/// Recycles bucket data between the driver and the render pass, so the
+/// render threads don't hit the allocator for every bucket.
+class HdAiBucketArena {
+public:
+    HdAiBucketArena() = default;
+    ~HdAiBucketArena();
+    HdAiBucketArena(const HdAiBucketArena&) = delete;
+    HdAiBucketArena& operator=(const HdAiBucketArena&) = delete;
+
+    /// Frees all the idle buckets and preallocates new ones, large enough to
+    /// hold \p bucketSize sized buckets, based on the number of buckets
+    /// rendering a \p width x \p height image and the number of threads.
+    void Reserve(int width, int height, int bucketSize);
+
+    /// Returns a bucket with enough storage for \p numPixels pixels.
+    HdAiBucketData* Acquire(size_t numPixels);
+
+    /// Returns \p data to the free list.
+    void Release(HdAiBucketData* data);
+
+    HdAiBucketArenaStats GetStats() const;
+
+private:
+    HdAiBucketData* _Allocate(size_t numPixels);
+
+    tbb::concurrent_queue<HdAiBucketData*> _freeList;
+    std::atomic<size_t> _numAllocations{0};
+    std::atomic<size_t> _numReuses{0};
+    std::atomic<size_t> _numInUse{0};
+    std::atomic<size_t> _peakInUse{0};
+    std::atomic<size_t> _reservedBytes{0};
+    std::atomic<size_t> _bucketPixels{0};
+};
+
+/// Hands buckets from a driver node to the render pass owning it. Each render
+/// pass owns its queue and passes it to its driver through the bucketQueue
+/// parameter, so multiple render passes never receive each other's buckets.
+class HdAiBucketQueue {
+public:
+    HdAiBucketQueue() = default;
+    ~HdAiBucketQueue();
+    HdAiBucketQueue(const HdAiBucketQueue&) = delete;
+    HdAiBucketQueue& operator=(const HdAiBucketQueue&) = delete;
+
+    HdAiBucketArena& GetArena() { return _arena; }
+
+    /// Called from the render threads.
+    void Push(HdAiBucketData* data);
+
+    /// Calls \p f on each queued bucket, then returns them to the arena.
+    void Empty(const std::function<void(const HdAiBucketData*)>& f);
+
+private:
+    tbb::concurrent_queue<HdAiBucketData*> _queue;
+    HdAiBucketArena _arena;
+};
 
 #endif
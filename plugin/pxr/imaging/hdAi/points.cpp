@@ -0,0 +1,266 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/points.h"
+
+#include <pxr/base/work/loops.h>
+
+#include <pxr/imaging/hdAi/instancer.h>
+#include <pxr/imaging/hdAi/material.h>
+#include <pxr/imaging/hdAi/utils.h>
+
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_PRIVATE_TOKENS(_tokens, (velocities)(accelerations));
+
+namespace {
+namespace Str {
+const AtString name("name");
+const AtString points("points");
+const AtString visibility("visibility");
+const AtString radius("radius");
+const AtString shader("shader");
+const AtString matrix("matrix");
+} // namespace Str
+
+// Constant primvar read on the sync thread, and written to the points when the
+// staged writes are committed.
+struct _Primvar {
+    TfToken name;
+    TfToken role;
+    VtValue value;
+};
+
+// Per point primvar, converted on the sync thread.
+struct _VaryingPrimvar {
+    TfToken name;
+    TfToken type;
+    AtArray* values;
+};
+
+// Converts the widths to the radius of the points. Particle sets can be
+// large, so the conversion is split into chunks running in parallel.
+AtArray* _ConvertWidths(const VtValue& value) {
+    if (!value.IsHolding<VtFloatArray>()) { return nullptr; }
+    const auto& widths = value.UncheckedGet<VtFloatArray>();
+    const auto numWidths = static_cast<uint32_t>(widths.size());
+    if (numWidths == 0) { return nullptr; }
+    auto* radius = AiArrayAllocate(numWidths, 1, AI_TYPE_FLOAT);
+    auto* out = static_cast<float*>(AiArrayMap(radius));
+    const auto* in = widths.cdata();
+    WorkParallelForN(numWidths, [out, in](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) { out[i] = in[i] * 0.5f; }
+    });
+    AiArrayUnmap(radius);
+    return radius;
+}
+
+} // namespace
+
+HdAiPoints::HdAiPoints(
+    HdAiRenderDelegate* delegate, const SdfPath& id, const SdfPath& instancerId)
+    : HdPoints(id, instancerId), _delegate(delegate) {
+    _points = AiNode(delegate->GetUniverse(), Str::points);
+    AiNodeSetStr(_points, Str::name, id.GetText());
+    _delegate->GetStats().NodeCreated();
+}
+
+HdAiPoints::~HdAiPoints() {
+    _delegate->GetMaterialBindings().Unbind(GetId());
+    _delegate->GetLightLinking().RemoveShape(_points);
+    // The instancer might be already destroyed.
+    for (auto* instance : _instances) {
+        _delegate->GetLightLinking().RemoveShape(instance);
+        AiNodeDestroy(instance);
+    }
+    _delegate->GetStats().NodeDestroyed(_instances.size());
+    AiNodeDestroy(_points);
+    _delegate->GetStats().NodeDestroyed();
+}
+
+void HdAiPoints::Sync(
+    HdSceneDelegate* delegate, HdRenderParam* renderParam,
+    HdDirtyBits* dirtyBits, const TfToken& reprToken) {
+    auto* param = reinterpret_cast<HdAiRenderParam*>(renderParam);
+    HdAiRenderStats::SyncTimer timer(
+        param->GetStats(), HdPrimTypeTokens->points);
+    const auto& id = GetId();
+    // Points are synced in parallel, like meshes, so the data is translated
+    // here and the writes to the Arnold nodes are staged.
+    auto* points = _points;
+
+    // The positions are sampled with the other deformation keys, and the
+    // velocities and accelerations are used when they are authored.
+    if (HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->points)) {
+        auto* positions = HdAiSampleDeformationKeys(
+            delegate, id, HdTokens->points, _pointSamples);
+        if (positions != nullptr) {
+            param->Stage([points, positions]() {
+                AiNodeSetArray(points, Str::points, positions);
+                HdAiSetMotionRange(points);
+            });
+        }
+    }
+
+    if (HdChangeTracker::IsPrimvarDirty(*dirtyBits, id, HdTokens->widths)) {
+        AtArray* radius = nullptr;
+        for (const auto interpolation :
+             {HdInterpolationConstant, HdInterpolationVarying,
+              HdInterpolationVertex}) {
+            for (const auto& primvar :
+                 delegate->GetPrimvarDescriptors(id, interpolation)) {
+                if (primvar.name != HdTokens->widths) { continue; }
+                if (radius != nullptr) { AiArrayDestroy(radius); }
+                radius = _ConvertWidths(delegate->Get(id, primvar.name));
+            }
+        }
+        param->Stage([points, radius]() {
+            if (radius != nullptr) {
+                AiNodeSetArray(points, Str::radius, radius);
+            } else {
+                AiNodeResetParameter(points, Str::radius.c_str());
+            }
+        });
+    }
+
+    auto visibilityChanged = false;
+    if (HdChangeTracker::IsVisibilityDirty(*dirtyBits, id)) {
+        _UpdateVisibility(delegate, dirtyBits);
+        visibilityChanged = true;
+    }
+
+    const uint8_t visibility = _sharedData.visible ? AI_RAY_ALL : uint8_t(0);
+    const auto& instancerId = GetInstancerId();
+    if (instancerId.IsEmpty()) {
+        if (visibilityChanged) {
+            param->Stage([points, visibility]() {
+                AiNodeSetByte(points, Str::visibility, visibility);
+            });
+        }
+    } else if (
+        visibilityChanged ||
+        HdChangeTracker::IsInstancerDirty(*dirtyBits, id) ||
+        HdChangeTracker::IsInstanceIndexDirty(*dirtyBits, id)) {
+        auto* instancer = dynamic_cast<HdAiInstancer*>(
+            delegate->GetRenderIndex().GetInstancer(instancerId));
+        if (instancer != nullptr) {
+            param->Stage([this, instancer, visibility]() {
+                // Only the ginstance nodes are rendered, the points are their
+                // source.
+                AiNodeSetByte(_points, Str::visibility, 0);
+                instancer->SyncInstances(
+                    _points, GetId(), visibility, _instances);
+            });
+        }
+    }
+
+    if (*dirtyBits & HdChangeTracker::DirtyCategories) {
+        const auto categories = delegate->GetCategories(id);
+        param->Stage([this, points, categories]() {
+            auto& lightLinking = _delegate->GetLightLinking();
+            lightLinking.SetShape(points, categories);
+            lightLinking.SetInstances(points, _instances);
+        });
+    }
+
+    if (HdChangeTracker::IsTransformDirty(*dirtyBits, id)) {
+        auto* matrices = HdAiSampleTransform(delegate, id);
+        param->Stage([points, matrices]() {
+            AiNodeSetArray(points, Str::matrix, matrices);
+        });
+    }
+
+    if (*dirtyBits & HdChangeTracker::DirtyMaterialId) {
+        const auto materialId = delegate->GetMaterialId(id);
+        param->Stage([this, materialId]() {
+            _delegate->GetMaterialBindings().Bind(GetId(), materialId);
+        });
+        const auto* material = reinterpret_cast<const HdAiMaterial*>(
+            delegate->GetRenderIndex().GetSprim(
+                HdPrimTypeTokens->material, materialId));
+        auto* shader = material != nullptr ? material->GetSurfaceShader()
+                                           : _delegate->GetFallbackShader();
+        param->Stage([points, shader]() {
+            AiNodeSetPtr(points, Str::shader, shader);
+        });
+    }
+
+    // Varying and vertex primvars both have one element per point.
+    if (*dirtyBits & HdChangeTracker::DirtyPrimvar) {
+        std::vector<_Primvar> primvars;
+        std::vector<_VaryingPrimvar> varyingPrimvars;
+        for (const auto interpolation :
+             {HdInterpolationConstant, HdInterpolationVarying,
+              HdInterpolationVertex}) {
+            for (const auto& primvar :
+                 delegate->GetPrimvarDescriptors(id, interpolation)) {
+                if (primvar.name == HdTokens->points ||
+                    primvar.name == HdTokens->widths ||
+                    primvar.name == _tokens->velocities ||
+                    primvar.name == _tokens->accelerations) {
+                    continue;
+                }
+                auto value = delegate->Get(id, primvar.name);
+                if (interpolation == HdInterpolationConstant) {
+                    primvars.push_back(
+                        {primvar.name, primvar.role, std::move(value)});
+                    continue;
+                }
+                // Per point arrays are copied here, in parallel, instead of
+                // on the thread committing the staged writes.
+                _VaryingPrimvar varying{primvar.name, TfToken(), nullptr};
+                varying.values = HdAiConvertPrimvarArray(
+                    value, primvar.role == HdPrimvarRoleTokens->color,
+                    varying.type);
+                if (varying.values != nullptr) {
+                    varyingPrimvars.push_back(varying);
+                }
+            }
+        }
+        param->Stage([points, primvars, varyingPrimvars]() {
+            for (const auto& primvar : primvars) {
+                HdAiSetConstantPrimvar(
+                    points, primvar.name, primvar.role, primvar.value);
+            }
+            for (const auto& primvar : varyingPrimvars) {
+                HdAiSetVaryingPrimvar(
+                    points, primvar.name, primvar.type, primvar.values);
+            }
+        });
+    }
+
+    *dirtyBits = HdChangeTracker::Clean;
+}
+
+HdDirtyBits HdAiPoints::GetInitialDirtyBitsMask() const {
+    return HdChangeTracker::Clean | HdChangeTracker::InitRepr |
+           HdChangeTracker::DirtyPoints | HdChangeTracker::DirtyTransform |
+           HdChangeTracker::DirtyMaterialId | HdChangeTracker::DirtyPrimvar |
+           HdChangeTracker::DirtyVisibility | HdChangeTracker::DirtyWidths |
+           HdChangeTracker::DirtyInstancer |
+           HdChangeTracker::DirtyInstanceIndex |
+           HdChangeTracker::DirtyCategories;
+}
+
+HdDirtyBits HdAiPoints::_PropagateDirtyBits(HdDirtyBits bits) const {
+    return bits & HdChangeTracker::AllDirty;
+}
+
+void HdAiPoints::_InitRepr(const TfToken& reprToken, HdDirtyBits* dirtyBits) {
+    TF_UNUSED(reprToken);
+    TF_UNUSED(dirtyBits);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,66 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_POINTS_H
+#define HDAI_POINTS_H
+
+#include <pxr/pxr.h>
+#include "pxr/imaging/hdAi/api.h"
+
+#include <pxr/imaging/hd/points.h>
+
+#include "pxr/imaging/hdAi/renderDelegate.h"
+#include "pxr/imaging/hdAi/utils.h"
+
+#include <ai.h>
+
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class HdAiPoints : public HdPoints {
+public:
+    HDAI_API
+    HdAiPoints(
+        HdAiRenderDelegate* delegate, const SdfPath& id,
+        const SdfPath& instancerId = SdfPath());
+
+    HDAI_API
+    ~HdAiPoints() override;
+
+    HDAI_API
+    void Sync(
+        HdSceneDelegate* delegate, HdRenderParam* renderParam,
+        HdDirtyBits* dirtyBits, const TfToken& reprToken) override;
+
+    HDAI_API
+    HdDirtyBits GetInitialDirtyBitsMask() const override;
+
+protected:
+    HDAI_API
+    HdDirtyBits _PropagateDirtyBits(HdDirtyBits bits) const override;
+
+    HDAI_API
+    void _InitRepr(const TfToken& reprToken, HdDirtyBits* dirtyBits) override;
+
+    HdAiRenderDelegate* _delegate;
+    AtNode* _points;
+    HdAiMotionSamples _pointSamples;
+    /// ginstance nodes of the points, when they are a prototype of an
+    /// instancer.
+    std::vector<AtNode*> _instances;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_POINTS_H
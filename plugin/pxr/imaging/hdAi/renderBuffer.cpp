@@ -13,37 +13,181 @@
 // limitations under the License.
 #include "pxr/imaging/hdAi/renderBuffer.h"
 
-#include "renderBuffer.h"
+#include <pxr/base/gf/half.h>
+
+#include <algorithm>
+#include <cstring> // memcpy
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+namespace {
+
+float _ReadComponent(HdFormat componentFormat, const uint8_t* data) {
+    switch (componentFormat) {
+        case HdFormatUNorm8:
+            return static_cast<float>(*data) / 255.0f;
+        case HdFormatSNorm8:
+            return std::max(
+                -1.0f, static_cast<float>(*reinterpret_cast<const int8_t*>(
+                           data)) / 127.0f);
+        case HdFormatFloat16:
+            return static_cast<float>(*reinterpret_cast<const GfHalf*>(data));
+        case HdFormatFloat32:
+            return *reinterpret_cast<const float*>(data);
+        default:
+            return 0.0f;
+    }
+}
+
+void _WriteComponent(HdFormat componentFormat, float value, uint8_t* data) {
+    switch (componentFormat) {
+        case HdFormatUNorm8:
+            *data = static_cast<uint8_t>(
+                std::max(0.0f, std::min(1.0f, value)) * 255.0f + 0.5f);
+            break;
+        case HdFormatSNorm8:
+            *reinterpret_cast<int8_t*>(data) = static_cast<int8_t>(
+                std::max(-1.0f, std::min(1.0f, value)) * 127.0f);
+            break;
+        case HdFormatFloat16:
+            *reinterpret_cast<GfHalf*>(data) = GfHalf(value);
+            break;
+        case HdFormatFloat32:
+            *reinterpret_cast<float*>(data) = value;
+            break;
+        default:
+            break;
+    }
+}
+
+// Converts a single pixel, missing channels are filled with zeros.
+void _ConvertPixel(
+    HdFormat dstFormat, uint8_t* dst, HdFormat srcFormat, const uint8_t* src) {
+    const auto srcComponentFormat = HdGetComponentFormat(srcFormat);
+    const auto dstComponentFormat = HdGetComponentFormat(dstFormat);
+    const auto srcComponentCount = HdGetComponentCount(srcFormat);
+    const auto dstComponentCount = HdGetComponentCount(dstFormat);
+    const auto srcComponentSize = HdDataSizeOfFormat(srcComponentFormat);
+    const auto dstComponentSize = HdDataSizeOfFormat(dstComponentFormat);
+    for (auto c = decltype(dstComponentCount){0}; c < dstComponentCount; ++c) {
+        _WriteComponent(
+            dstComponentFormat,
+            c < srcComponentCount
+                ? _ReadComponent(srcComponentFormat, src + c * srcComponentSize)
+                : 0.0f,
+            dst + c * dstComponentSize);
+    }
+}
+
+} // namespace
+
 HdAiRenderBuffer::HdAiRenderBuffer(const SdfPath& id) : HdRenderBuffer(id) {}
 
 bool HdAiRenderBuffer::Allocate(
     const GfVec3i& dimensions, HdFormat format, bool multiSampled) {
-    return false;
+    TF_UNUSED(multiSampled);
+    if (dimensions[2] != 1) {
+        TF_WARN(
+            "Render buffer allocated with dims <%d, %d, %d> and format %s; "
+            "depth must be 1!",
+            dimensions[0], dimensions[1], dimensions[2],
+            TfEnum::GetName(format).c_str());
+        return false;
+    }
+    if (format == HdFormatInvalid) { return false; }
+    _width = static_cast<unsigned int>(std::max(0, dimensions[0]));
+    _height = static_cast<unsigned int>(std::max(0, dimensions[1]));
+    _format = format;
+    _buffer.resize(
+        static_cast<size_t>(_width) * _height * HdDataSizeOfFormat(_format));
+    _converged.store(false);
+    return true;
 }
 
-unsigned int HdAiRenderBuffer::GetWidth() const { return 0; }
+unsigned int HdAiRenderBuffer::GetWidth() const { return _width; }
 
-unsigned int HdAiRenderBuffer::GetHeight() const { return 0; }
+unsigned int HdAiRenderBuffer::GetHeight() const { return _height; }
 
-unsigned int HdAiRenderBuffer::GetDepth() const { return 0; }
+unsigned int HdAiRenderBuffer::GetDepth() const { return 1; }
 
-HdFormat HdAiRenderBuffer::GetFormat() const { return HdFormatUNorm8; }
+HdFormat HdAiRenderBuffer::GetFormat() const { return _format; }
 
 bool HdAiRenderBuffer::IsMultiSampled() const { return false; }
 
-uint8_t* HdAiRenderBuffer::Map() { return nullptr; }
+uint8_t* HdAiRenderBuffer::Map() {
+    _mappers.fetch_add(1);
+    return _buffer.empty() ? nullptr : _buffer.data();
+}
 
-void HdAiRenderBuffer::Unmap() {}
+void HdAiRenderBuffer::Unmap() { _mappers.fetch_sub(1); }
 
-bool HdAiRenderBuffer::IsMapped() const { return false; }
+bool HdAiRenderBuffer::IsMapped() const { return _mappers.load() != 0; }
 
 void HdAiRenderBuffer::Resolve() {}
 
-bool HdAiRenderBuffer::IsConverged() const { return false; }
+bool HdAiRenderBuffer::IsConverged() const { return _converged.load(); }
+
+void HdAiRenderBuffer::SetConverged(bool converged) {
+    _converged.store(converged);
+}
+
+void HdAiRenderBuffer::WriteBucket(
+    int bucketXO, int bucketYO, int bucketWidth, int bucketHeight,
+    HdFormat format, const void* bucketData) {
+    if (_buffer.empty() || bucketData == nullptr) { return; }
+    const auto width = static_cast<int>(_width);
+    const auto height = static_cast<int>(_height);
+    const auto xo = std::max(0, bucketXO);
+    const auto xe = std::min(width, bucketXO + bucketWidth);
+    if (xe <= xo) { return; }
+    const auto yo = std::max(0, bucketYO);
+    const auto ye = std::min(height, bucketYO + bucketHeight);
+    if (ye <= yo) { return; }
+
+    const auto srcPixelSize = HdDataSizeOfFormat(format);
+    const auto dstPixelSize = HdDataSizeOfFormat(_format);
+    const auto* src = reinterpret_cast<const uint8_t*>(bucketData);
+    const auto numPixels = static_cast<size_t>(xe - xo);
+    for (auto y = yo; y < ye; ++y) {
+        const auto* srcRow =
+            src + (static_cast<size_t>(y - bucketYO) * bucketWidth + xo -
+                   bucketXO) *
+                      srcPixelSize;
+        auto* dstRow = _buffer.data() +
+                       (static_cast<size_t>(height - 1 - y) * width + xo) *
+                           dstPixelSize;
+        if (format == _format) {
+            memcpy(dstRow, srcRow, numPixels * dstPixelSize);
+        } else {
+            for (auto i = decltype(numPixels){0}; i < numPixels; ++i) {
+                _ConvertPixel(
+                    _format, dstRow + i * dstPixelSize, format,
+                    srcRow + i * srcPixelSize);
+            }
+        }
+    }
+}
+
+void HdAiRenderBuffer::Clear(const GfVec4f& value) {
+    if (_buffer.empty()) { return; }
+    const auto pixelSize = HdDataSizeOfFormat(_format);
+    std::vector<uint8_t> pixel(pixelSize);
+    _ConvertPixel(
+        _format, pixel.data(), HdFormatFloat32Vec4,
+        reinterpret_cast<const uint8_t*>(value.data()));
+    for (size_t offset = 0; offset < _buffer.size(); offset += pixelSize) {
+        memcpy(_buffer.data() + offset, pixel.data(), pixelSize);
+    }
+}
 
-void HdAiRenderBuffer::_Deallocate() {}
+void HdAiRenderBuffer::_Deallocate() {
+    decltype(_buffer) tmp;
+    _buffer.swap(tmp);
+    _width = 0;
+    _height = 0;
+    _format = HdFormatInvalid;
+    _mappers.store(0);
+    _converged.store(false);
+}
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -17,8 +17,12 @@
 #include <pxr/pxr.h>
 #include "pxr/imaging/hdAi/api.h"
 
+#include <pxr/base/gf/vec4f.h>
 #include <pxr/imaging/hd/renderBuffer.h>
 
+#include <atomic>
+#include <vector>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 class HdAiRenderBuffer : public HdRenderBuffer {
@@ -53,9 +57,33 @@ public:
     HDAI_API
     bool IsConverged() const override;
 
+    /// Marks the buffer as converged, set by the render pass once Arnold
+    /// finishes the current render.
+    HDAI_API
+    void SetConverged(bool converged);
+
+    /// Writes a bucket of pixels, converting from \p format to the format of
+    /// the render buffer. Buckets are top-down, so they are flipped vertically
+    /// and clipped to the dimensions of the buffer.
+    HDAI_API
+    void WriteBucket(
+        int bucketXO, int bucketYO, int bucketWidth, int bucketHeight,
+        HdFormat format, const void* bucketData);
+
+    /// Fills every pixel with \p value, converted to the format of the buffer.
+    HDAI_API
+    void Clear(const GfVec4f& value);
+
 protected:
     HDAI_API
     void _Deallocate() override;
+
+    std::vector<uint8_t> _buffer;
+    unsigned int _width = 0;
+    unsigned int _height = 0;
+    HdFormat _format = HdFormatInvalid;
+    std::atomic<int> _mappers{0};
+    std::atomic<bool> _converged{false};
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
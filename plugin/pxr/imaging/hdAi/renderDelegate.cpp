@@ -23,22 +23,28 @@
 #include <pxr/imaging/hd/rprim.h>
 #include <pxr/imaging/hd/tokens.h>
 
+#include "pxr/imaging/hdAi/basisCurves.h"
 #include "pxr/imaging/hdAi/config.h"
+#include "pxr/imaging/hdAi/instancer.h"
 #include "pxr/imaging/hdAi/light.h"
 #include "pxr/imaging/hdAi/material.h"
 #include "pxr/imaging/hdAi/mesh.h"
 #include "pxr/imaging/hdAi/nodes/nodes.h"
 #include "pxr/imaging/hdAi/openvdbAsset.h"
+#include "pxr/imaging/hdAi/points.h"
 #include "pxr/imaging/hdAi/renderBuffer.h"
 #include "pxr/imaging/hdAi/renderPass.h"
 #include "pxr/imaging/hdAi/volume.h"
 
+#include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
-TF_DEFINE_PRIVATE_TOKENS(_tokens, (openvdbAsset));
+TF_DEFINE_PRIVATE_TOKENS(
+    _tokens, (openvdbAsset)(AA_samples)(enable_progressive_render)(
+                 progressiveLadder)(passTimes)(passTimeBudget));
 
 namespace {
 // The following patters might look a bit weird at first glance, but
@@ -146,7 +152,9 @@ bool _SetNodeParam(AtNode* node, const TfToken& key, const VtValue& value) {
 
 inline const TfTokenVector& _SupportedRprimTypes() {
     static const TfTokenVector r{HdPrimTypeTokens->mesh,
-                                 HdPrimTypeTokens->volume};
+                                 HdPrimTypeTokens->volume,
+                                 HdPrimTypeTokens->basisCurves,
+                                 HdPrimTypeTokens->points};
     return r;
 }
 
@@ -193,6 +201,14 @@ HdAiRenderDelegate::HdAiRenderDelegate() {
         _SetNodeParam(_options, o.first, o.second);
     }
 
+    _renderParam.reset(new HdAiRenderParam(_options));
+    _geometryRegistry.reset(
+        new HdAiGeometryRegistry(_universe, _renderParam->GetStats()));
+    _shaderRegistry.reset(new HdAiShaderRegistry(_renderParam->GetStats()));
+    _textureCache.reset(new HdAiTextureCache());
+    _lightLinking.reset(new HdAiLightLinking());
+    _materialBindings.reset(new HdAiMaterialBindings());
+
     _fallbackShader = AiNode(_universe, "utility");
     AiNodeSetStr(_fallbackShader, "shade_mode", "ambocc");
     AiNodeSetStr(_fallbackShader, "color_mode", "color");
@@ -200,8 +216,7 @@ HdAiRenderDelegate::HdAiRenderDelegate() {
     AiNodeSetStr(userDataReader, "attribute", "color");
     AiNodeSetRGBA(userDataReader, "default", 1.0f, 1.0f, 1.0f, 1.0f);
     AiNodeLink(userDataReader, "color", _fallbackShader);
-
-    _renderParam.reset(new HdAiRenderParam());
+    GetStats().NodeCreated(2);
 }
 
 HdAiRenderDelegate::~HdAiRenderDelegate() {
@@ -210,6 +225,11 @@ HdAiRenderDelegate::~HdAiRenderDelegate() {
         _resourceRegistry.reset();
     }
     _renderParam->End();
+    _geometryRegistry.reset();
+    _shaderRegistry.reset();
+    _textureCache.reset();
+    _lightLinking.reset();
+    _materialBindings.reset();
     hdAiUninstallNodes();
     AiUniverseDestroy(_universe);
     AiEnd();
@@ -219,8 +239,36 @@ HdRenderParam* HdAiRenderDelegate::GetRenderParam() const {
     return _renderParam.get();
 }
 
+HdAiRenderStats& HdAiRenderDelegate::GetStats() const {
+    return _renderParam->GetStats();
+}
+
+HdAiGeometryRegistry& HdAiRenderDelegate::GetGeometryRegistry() const {
+    return *_geometryRegistry;
+}
+
+HdAiShaderRegistry& HdAiRenderDelegate::GetShaderRegistry() const {
+    return *_shaderRegistry;
+}
+
+HdAiTextureCache& HdAiRenderDelegate::GetTextureCache() const {
+    return *_textureCache;
+}
+
+HdAiLightLinking& HdAiRenderDelegate::GetLightLinking() const {
+    return *_lightLinking;
+}
+
+HdAiMaterialBindings& HdAiRenderDelegate::GetMaterialBindings() const {
+    return *_materialBindings;
+}
+
 void HdAiRenderDelegate::CommitResources(HdChangeTracker* tracker) {
     TF_UNUSED(tracker);
+    _renderParam->CommitStaged();
+    _textureCache->ApplyFinished(_universe, *_renderParam);
+    // Shapes are committed first, so the groups see their new collections.
+    _lightLinking->Update(*_renderParam);
 }
 
 const TfTokenVector& HdAiRenderDelegate::GetSupportedRprimTypes() const {
@@ -237,10 +285,29 @@ const TfTokenVector& HdAiRenderDelegate::GetSupportedBprimTypes() const {
 
 void HdAiRenderDelegate::SetRenderSetting(
     const TfToken& key, const VtValue& value) {
-    if (_SetNodeParam(_options, key, value)) { _renderParam->End(); }
+    // The render param schedules the progressive passes, so it owns these.
+    if (key == _tokens->AA_samples) {
+        if (value.IsHolding<int>()) {
+            _renderParam->SetAASamples(value.UncheckedGet<int>());
+        }
+        return;
+    }
+    if (key == _tokens->enable_progressive_render) {
+        if (value.IsHolding<bool>()) {
+            _renderParam->SetProgressive(value.UncheckedGet<bool>());
+        }
+        return;
+    }
+    if (_SetNodeParam(_options, key, value)) { _renderParam->Interrupt(); }
 }
 
 VtValue HdAiRenderDelegate::GetRenderSetting(const TfToken& key) const {
+    if (key == _tokens->AA_samples) {
+        return VtValue(_renderParam->GetAASamples());
+    }
+    if (key == _tokens->enable_progressive_render) {
+        return VtValue(_renderParam->GetProgressive());
+    }
     const auto* nentry = AiNodeGetNodeEntry(_options);
     const auto* pentry = AiNodeEntryLookUpParameter(nentry, key.GetText());
     if (pentry == nullptr) { return {}; }
@@ -307,6 +374,27 @@ HdRenderSettingDescriptorList HdAiRenderDelegate::GetRenderSettingDescriptors()
     return ret;
 }
 
+VtDictionary HdAiRenderDelegate::GetRenderStats() const {
+    auto stats = _renderParam->GetStats().GetStats();
+    for (const auto& it : _geometryRegistry->GetStats()) {
+        stats[it.first] = it.second;
+    }
+    for (const auto& it : _shaderRegistry->GetStats()) {
+        stats[it.first] = it.second;
+    }
+    const auto& ladder = _renderParam->GetProgressiveLadder();
+    VtIntArray ladderArray(ladder.size());
+    std::copy(ladder.begin(), ladder.end(), ladderArray.begin());
+    stats[_tokens->progressiveLadder.GetString()] = VtValue(ladderArray);
+    const auto& passTimes = _renderParam->GetPassTimes();
+    VtDoubleArray passTimesArray(passTimes.size());
+    std::copy(passTimes.begin(), passTimes.end(), passTimesArray.begin());
+    stats[_tokens->passTimes.GetString()] = VtValue(passTimesArray);
+    stats[_tokens->passTimeBudget.GetString()] =
+        VtValue(_renderParam->GetPassTimeBudget());
+    return stats;
+}
+
 HdResourceRegistrySharedPtr HdAiRenderDelegate::GetResourceRegistry() const {
     return _resourceRegistry;
 }
@@ -318,10 +406,7 @@ HdRenderPassSharedPtr HdAiRenderDelegate::CreateRenderPass(
 
 HdInstancer* HdAiRenderDelegate::CreateInstancer(
     HdSceneDelegate* delegate, const SdfPath& id, const SdfPath& instancerId) {
-    TF_UNUSED(delegate);
-    TF_UNUSED(id);
-    TF_UNUSED(instancerId);
-    return nullptr;
+    return new HdAiInstancer(this, delegate, id, instancerId);
 }
 
 void HdAiRenderDelegate::DestroyInstancer(HdInstancer* instancer) {
@@ -330,25 +415,31 @@ void HdAiRenderDelegate::DestroyInstancer(HdInstancer* instancer) {
 
 HdRprim* HdAiRenderDelegate::CreateRprim(
     const TfToken& typeId, const SdfPath& rprimId, const SdfPath& instancerId) {
-    _renderParam->End();
+    _renderParam->Interrupt();
     if (typeId == HdPrimTypeTokens->mesh) {
         return new HdAiMesh(this, rprimId, instancerId);
     }
     if (typeId == HdPrimTypeTokens->volume) {
         return new HdAiVolume(this, rprimId, instancerId);
     }
+    if (typeId == HdPrimTypeTokens->basisCurves) {
+        return new HdAiBasisCurves(this, rprimId, instancerId);
+    }
+    if (typeId == HdPrimTypeTokens->points) {
+        return new HdAiPoints(this, rprimId, instancerId);
+    }
     TF_CODING_ERROR("Unknown Rprim Type %s", typeId.GetText());
     return nullptr;
 }
 
 void HdAiRenderDelegate::DestroyRprim(HdRprim* rPrim) {
-    _renderParam->End();
+    _renderParam->Interrupt();
     delete rPrim;
 }
 
 HdSprim* HdAiRenderDelegate::CreateSprim(
     const TfToken& typeId, const SdfPath& sprimId) {
-    _renderParam->End();
+    _renderParam->Interrupt();
     if (typeId == HdPrimTypeTokens->camera) { return new HdCamera(sprimId); }
     if (typeId == HdPrimTypeTokens->material) {
         return new HdAiMaterial(this, sprimId);
@@ -405,7 +496,7 @@ HdSprim* HdAiRenderDelegate::CreateFallbackSprim(const TfToken& typeId) {
 }
 
 void HdAiRenderDelegate::DestroySprim(HdSprim* sPrim) {
-    _renderParam->End();
+    _renderParam->Interrupt();
     delete sPrim;
 }
 
@@ -438,6 +529,18 @@ TfToken HdAiRenderDelegate::GetMaterialBindingPurpose() const {
     return HdTokens->full;
 }
 
+HdAovDescriptor HdAiRenderDelegate::GetDefaultAovDescriptor(
+    const TfToken& name) const {
+    if (name == HdAovTokens->color) {
+        return HdAovDescriptor(
+            HdFormatFloat32Vec4, false, VtValue(GfVec4f(0.0f)));
+    }
+    if (name == HdAovTokens->depth) {
+        return HdAovDescriptor(HdFormatFloat32, false, VtValue(1.0f));
+    }
+    return HdAovDescriptor();
+}
+
 AtString HdAiRenderDelegate::GetLocalNodeName(const AtString& name) const {
     return AtString(_id.AppendChild(TfToken(name.c_str())).GetText());
 }
@@ -17,11 +17,17 @@
 #include <pxr/pxr.h>
 #include "pxr/imaging/hdAi/api.h"
 
+#include <pxr/imaging/hd/aov.h>
 #include <pxr/imaging/hd/renderDelegate.h>
 #include <pxr/imaging/hd/renderThread.h>
 #include <pxr/imaging/hd/resourceRegistry.h>
 
+#include "pxr/imaging/hdAi/geometryRegistry.h"
+#include "pxr/imaging/hdAi/lightLinking.h"
+#include "pxr/imaging/hdAi/materialBindings.h"
 #include "pxr/imaging/hdAi/renderParam.h"
+#include "pxr/imaging/hdAi/shaderRegistry.h"
+#include "pxr/imaging/hdAi/textureCache.h"
 
 #include <ai.h>
 
@@ -48,6 +54,8 @@ public:
     HDAI_API
     HdRenderSettingDescriptorList GetRenderSettingDescriptors() const override;
     HDAI_API
+    VtDictionary GetRenderStats() const override;
+    HDAI_API
     HdResourceRegistrySharedPtr GetResourceRegistry() const override;
     HDAI_API
     HdRenderPassSharedPtr CreateRenderPass(
@@ -82,6 +90,9 @@ public:
     void CommitResources(HdChangeTracker* tracker) override;
     HDAI_API
     TfToken GetMaterialBindingPurpose() const override;
+    HDAI_API
+    HdAovDescriptor GetDefaultAovDescriptor(
+        TfToken const& name) const override;
 
     HDAI_API
     AtString GetLocalNodeName(const AtString& name) const;
@@ -95,6 +106,30 @@ public:
     HDAI_API
     AtNode* GetFallbackShader() const;
 
+    /// Returns the statistics reported through GetRenderStats.
+    HDAI_API
+    HdAiRenderStats& GetStats() const;
+
+    /// Returns the registry deduplicating the geometry of the meshes.
+    HDAI_API
+    HdAiGeometryRegistry& GetGeometryRegistry() const;
+
+    /// Returns the registry sharing shader subgraphs between materials.
+    HDAI_API
+    HdAiShaderRegistry& GetShaderRegistry() const;
+
+    /// Returns the cache converting the textures to tx files.
+    HDAI_API
+    HdAiTextureCache& GetTextureCache() const;
+
+    /// Returns the registry translating light and shadow linking.
+    HDAI_API
+    HdAiLightLinking& GetLightLinking() const;
+
+    /// Returns the registry of the materials bound to the rprims.
+    HDAI_API
+    HdAiMaterialBindings& GetMaterialBindings() const;
+
 private:
     static std::mutex _mutexResourceRegistry;
     static std::atomic_int _counterResourceRegistry;
@@ -103,6 +138,11 @@ private:
     HdAiRenderDelegate& operator=(const HdAiRenderDelegate&) = delete;
 
     std::unique_ptr<HdAiRenderParam> _renderParam;
+    std::unique_ptr<HdAiGeometryRegistry> _geometryRegistry;
+    std::unique_ptr<HdAiShaderRegistry> _shaderRegistry;
+    std::unique_ptr<HdAiTextureCache> _textureCache;
+    std::unique_ptr<HdAiLightLinking> _lightLinking;
+    std::unique_ptr<HdAiMaterialBindings> _materialBindings;
     SdfPath _id;
     AtUniverse* _universe;
     AtNode* _options;
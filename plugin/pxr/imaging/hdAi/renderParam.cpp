@@ -13,37 +13,110 @@
 // limitations under the License.
 #include "pxr/imaging/hdAi/renderParam.h"
 
-#include <ai.h>
+#include "pxr/imaging/hdAi/config.h"
+
+#include <algorithm>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+namespace {
+namespace Str {
+const AtString AA_samples("AA_samples");
+const AtString enable_progressive_render("enable_progressive_render");
+} // namespace Str
+
+// Passes rendered before the final one, when they are above the minimum and
+// below the final AA samples.
+constexpr int _progressiveAASamples[] = {-1, 1};
+} // namespace
+
+HdAiRenderParam::HdAiRenderParam(AtNode* options) : _options(options) {
+    const auto& config = HdAiConfig::GetInstance();
+    _AASamples = config.AA_samples;
+    _progressive = config.enable_progressive_render;
+    _passTimeBudget = 1000.0 / config.interactive_target_fps;
+    // We render the progressive passes ourselves.
+    AiNodeSetBool(_options, Str::enable_progressive_render, false);
+    AiNodeSetInt(_options, Str::AA_samples, _AASamples);
+}
+
 bool HdAiRenderParam::Render() {
+    _finished = false;
     const auto status = AiRenderGetStatus();
     if (status == AI_RENDER_STATUS_NOT_STARTED) {
+        _needsRestart.store(false);
+        _StartLadder();
         AiRenderBegin();
         return false;
     }
-    if (status == AI_RENDER_STATUS_PAUSED) {
+    if (status == AI_RENDER_STATUS_PAUSED ||
+        (status == AI_RENDER_STATUS_FINISHED && _needsRestart.load())) {
+        _needsRestart.store(false);
+        _stats.RenderRestarted();
+        _StartLadder();
         AiRenderRestart();
         return false;
     }
-    if (status == AI_RENDER_STATUS_FINISHED) { return true; }
+    if (status == AI_RENDER_STATUS_FINISHED) {
+        _FinishPass();
+        if (_currentPass + 1 < _ladder.size()) {
+            ++_currentPass;
+            _StartPass();
+            AiRenderRestart();
+            return false;
+        }
+        _finished = true;
+        return true;
+    }
     if (status == AI_RENDER_STATUS_RESTARTING) { return false; }
+    if (status == AI_RENDER_STATUS_RENDERING) { return false; }
     AiRenderBegin();
     return false;
 }
 
-void HdAiRenderParam::Restart() {
+void HdAiRenderParam::Interrupt(bool editsScene) {
+    std::lock_guard<std::mutex> guard(_interruptMutex);
+    if (editsScene) { _sceneVersion.fetch_add(1); }
+    _finished = false;
     const auto status = AiRenderGetStatus();
-    if (status != AI_RENDER_STATUS_NOT_STARTED) {
-        if (status == AI_RENDER_STATUS_RENDERING) {
-            AiRenderInterrupt(AI_BLOCKING);
-        } else if (status == AI_RENDER_STATUS_FINISHED) {
-            AiRenderRestart();
+    if (status == AI_RENDER_STATUS_NOT_STARTED) { return; }
+    _needsRestart.store(true);
+    if (status == AI_RENDER_STATUS_RENDERING ||
+        status == AI_RENDER_STATUS_RESTARTING) {
+        AiRenderInterrupt(AI_BLOCKING);
+    }
+    // The interrupted pass still counts toward the render time.
+    if (_passRunning && status != AI_RENDER_STATUS_FINISHED) {
+        _passRunning = false;
+        _stats.AddRenderTime(_GetPassTime());
+    }
+}
+
+void HdAiRenderParam::CommitStaged() {
+    auto interrupted = false;
+    for (auto& writes : _staged) {
+        if (writes.empty()) { continue; }
+        if (!interrupted) {
+            Interrupt();
+            interrupted = true;
         }
+        for (auto& write : writes) { write(); }
+        writes.clear();
     }
 }
 
+bool HdAiRenderParam::AcquirePass(const void* pass) {
+    if (_activePass == pass) { return true; }
+    if (_activePass != nullptr && !_finished) { return false; }
+    Interrupt(false);
+    _activePass = pass;
+    return true;
+}
+
+void HdAiRenderParam::ReleasePass(const void* pass) {
+    if (_activePass == pass) { _activePass = nullptr; }
+}
+
 void HdAiRenderParam::End() {
     const auto status = AiRenderGetStatus();
     if (status != AI_RENDER_STATUS_NOT_STARTED) {
@@ -53,6 +126,88 @@ void HdAiRenderParam::End() {
         }
         AiRenderEnd();
     }
+    _needsRestart.store(false);
+    _passRunning = false;
+    _finished = false;
+}
+
+void HdAiRenderParam::SetAASamples(int AASamples) {
+    AASamples = std::max(1, AASamples);
+    if (AASamples == _AASamples) { return; }
+    Interrupt();
+    _AASamples = AASamples;
+    // Timings of the old final pass are not comparable anymore.
+    _measuredTimes.clear();
+}
+
+void HdAiRenderParam::SetProgressive(bool progressive) {
+    if (progressive == _progressive) { return; }
+    Interrupt();
+    _progressive = progressive;
+}
+
+void HdAiRenderParam::_StartLadder() {
+    _ladder.clear();
+    _passTimes.clear();
+    if (_progressive) {
+        const auto minAASamples =
+            HdAiConfig::GetInstance().progressive_min_AA_samples;
+        if (minAASamples < _AASamples) { _ladder.push_back(minAASamples); }
+        for (const auto AASamples : _progressiveAASamples) {
+            if (AASamples > minAASamples && AASamples < _AASamples) {
+                _ladder.push_back(AASamples);
+            }
+        }
+    }
+    _ladder.push_back(_AASamples);
+    // Skip the low quality passes if a higher quality pass was fast enough
+    // last time, so the first result comes in within the budget, at the
+    // highest quality possible.
+    size_t firstPass = 0;
+    for (auto i = decltype(_ladder.size()){1}; i < _ladder.size(); ++i) {
+        const auto it = std::find_if(
+            _measuredTimes.begin(), _measuredTimes.end(),
+            [&](const PassTiming& timing) -> bool {
+                return timing.AASamples == _ladder[i];
+            });
+        if (it == _measuredTimes.end() || it->time > _passTimeBudget) {
+            break;
+        }
+        firstPass = i;
+    }
+    _ladder.erase(_ladder.begin(), _ladder.begin() + firstPass);
+    _currentPass = 0;
+    _StartPass();
+}
+
+void HdAiRenderParam::_StartPass() {
+    AiNodeSetInt(_options, Str::AA_samples, _ladder[_currentPass]);
+    _passStart = Clock::now();
+    _passRunning = true;
+}
+
+void HdAiRenderParam::_FinishPass() {
+    if (!_passRunning) { return; }
+    _passRunning = false;
+    const auto time = _GetPassTime();
+    _stats.AddRenderTime(time);
+    _passTimes.push_back(time);
+    const auto AASamples = _ladder[_currentPass];
+    auto it = std::find_if(
+        _measuredTimes.begin(), _measuredTimes.end(),
+        [&](const PassTiming& timing) -> bool {
+            return timing.AASamples == AASamples;
+        });
+    if (it == _measuredTimes.end()) {
+        _measuredTimes.push_back({AASamples, time});
+    } else {
+        it->time = time;
+    }
+}
+
+double HdAiRenderParam::_GetPassTime() const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - _passStart)
+        .count();
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -18,15 +18,115 @@
 
 #include <pxr/imaging/hd/renderDelegate.h>
 
+#include "pxr/imaging/hdAi/renderStats.h"
+
+#include <ai.h>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 class HdAiRenderParam final : public HdRenderParam {
 public:
+    /// The render param drives the AA_samples and enable_progressive_render
+    /// parameters of \p options, so progressive passes are scheduled from
+    /// their measured time instead of by Arnold.
+    HdAiRenderParam(AtNode* options);
     ~HdAiRenderParam() override = default;
 
+    /// Starts or resumes rendering, returns true if the render is finished.
     bool Render();
-    void Restart();
+    /// Interrupts the render, so the scene can be edited. All the edits
+    /// between an interrupt and the next call to Render are picked up by a
+    /// single AiRenderRestart, instead of tearing down the render session.
+    /// \p editsScene is false when only the camera or the outputs of the
+    /// active render pass change, which the other passes don't depend on.
+    void Interrupt(bool editsScene = true);
+    /// Aborts and ends the render session.
     void End();
+
+    using StagedWrite = std::function<void()>;
+    /// Queues a write to the Arnold universe. Hydra syncs the rprims in
+    /// parallel, so the prims translate their data on their own thread and
+    /// stage the node creation and parameter writes, which are committed in
+    /// a single serialized batch by CommitStaged. Safe to call from multiple
+    /// threads.
+    void Stage(StagedWrite&& write) {
+        _staged.local().push_back(std::move(write));
+    }
+    /// Interrupts the render if needed and runs the staged writes on the
+    /// calling thread, in the order they were staged on each thread.
+    void CommitStaged();
+
+    /// Arnold renders a single camera and set of outputs per universe, so the
+    /// render passes sharing a delegate take turns. \p pass becomes the
+    /// active pass if there is none, or once the active pass finished
+    /// rendering. Returns true if \p pass is the active pass.
+    bool AcquirePass(const void* pass);
+    /// Clears the active pass if it's \p pass.
+    void ReleasePass(const void* pass);
+    /// Returns the render pass owning the camera and the outputs.
+    const void* GetActivePass() const { return _activePass; }
+    /// Returns a counter incremented by every edit of the scene, so inactive
+    /// render passes know when their last image is out of date.
+    size_t GetSceneVersion() const { return _sceneVersion.load(); }
+
+    /// Sets the AA samples of the final pass.
+    void SetAASamples(int AASamples);
+    int GetAASamples() const { return _AASamples; }
+    /// Enables rendering the progressive passes before the final pass.
+    void SetProgressive(bool progressive);
+    bool GetProgressive() const { return _progressive; }
+
+    /// Returns the AA samples of the passes scheduled for the current render.
+    const std::vector<int>& GetProgressiveLadder() const { return _ladder; }
+    /// Returns the time in milliseconds of the finished passes of the current
+    /// render, in the order of the progressive ladder.
+    const std::vector<double>& GetPassTimes() const { return _passTimes; }
+    /// Returns the time budget of a pass in milliseconds.
+    double GetPassTimeBudget() const { return _passTimeBudget; }
+
+    /// Returns the statistics shared by the prims and the render passes.
+    HdAiRenderStats& GetStats() { return _stats; }
+    const HdAiRenderStats& GetStats() const { return _stats; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PassTiming {
+        int AASamples;
+        double time;
+    };
+
+    void _StartLadder();
+    void _StartPass();
+    void _FinishPass();
+    double _GetPassTime() const;
+
+    HdAiRenderStats _stats;
+    tbb::enumerable_thread_specific<std::vector<StagedWrite>> _staged;
+    std::mutex _interruptMutex;
+    std::atomic<bool> _needsRestart{false};
+    std::atomic<size_t> _sceneVersion{0};
+    const void* _activePass = nullptr;
+    AtNode* _options;
+    // Last measured time of each possible pass.
+    std::vector<PassTiming> _measuredTimes;
+    std::vector<int> _ladder;
+    std::vector<double> _passTimes;
+    Clock::time_point _passStart;
+    double _passTimeBudget = 0.0;
+    size_t _currentPass = 0;
+    int _AASamples = 1;
+    bool _progressive = true;
+    bool _passRunning = false;
+    bool _finished = false;
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
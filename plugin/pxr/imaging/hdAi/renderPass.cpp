@@ -11,20 +11,19 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
-/*
- * TODO:
- * - Writing to the render buffers directly.
- */
+#include <pxr/imaging/glf/glew.h>
+
 #include "pxr/imaging/hdAi/renderPass.h"
 
+#include <pxr/imaging/hd/aov.h>
 #include <pxr/imaging/hd/renderPassState.h>
 
 #include "pxr/imaging/hdAi/config.h"
+#include "pxr/imaging/hdAi/debugCodes.h"
 #include "pxr/imaging/hdAi/nodes/nodes.h"
 #include "pxr/imaging/hdAi/utils.h"
 
 #include <algorithm>
-#include <cstring> // memset
 
 namespace {
 namespace Str {
@@ -45,18 +44,73 @@ const AtString shutter_end("shutter_end");
 const AtString fov("fov");
 const AtString xres("xres");
 const AtString yres("yres");
+const AtString bucket_size("bucket_size");
 } // namespace Str
 } // namespace
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+namespace {
+
+HdFormat _GetBeautyHdFormat(HdAiBeautyFormat format) {
+    if (format == HdAiBeautyFormat::Float32) { return HdFormatFloat32Vec4; }
+    if (format == HdAiBeautyFormat::Float16) { return HdFormatFloat16Vec4; }
+    return HdFormatUNorm8Vec4;
+}
+
+void _AllocateTexture(
+    GLuint& texture, GLint internalFormat, GLenum format, GLenum type,
+    int width, int height, const void* data) {
+    if (texture == 0) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+    glTexImage2D(
+        GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
+}
+
+// Uploads a rectangle of a full frame buffer, stored with a row length of
+// width pixels, to the currently bound texture.
+void _UploadTile(
+    const GfRect2i& tile, int width, GLenum format, GLenum type,
+    const void* data) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, tile.GetMinX());
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, tile.GetMinY());
+    glTexSubImage2D(
+        GL_TEXTURE_2D, 0, tile.GetMinX(), tile.GetMinY(), tile.GetWidth(),
+        tile.GetHeight(), format, type, data);
+}
+
+void _DebugBucketArenaStats(HdAiBucketArena& arena, const char* context) {
+    if (!TfDebug::IsEnabled(HDAI_BUCKET_ARENA)) { return; }
+    const auto stats = arena.GetStats();
+    TF_DEBUG(HDAI_BUCKET_ARENA)
+        .Msg(
+            "HdAiRenderPass::%s - bucket arena allocations: %zu, reuses: "
+            "%zu, in use: %zu, peak in use: %zu, reserved bytes: %zu\n",
+            context, stats.numAllocations, stats.numReuses, stats.numInUse,
+            stats.peakInUse, stats.reservedBytes);
+}
+
+} // namespace
+
 HdAiRenderPass::HdAiRenderPass(
     HdAiRenderDelegate* delegate, HdRenderIndex* index,
     const HdRprimCollection& collection)
-    : HdRenderPass(index, collection), _delegate(delegate) {
+    : HdRenderPass(index, collection),
+      _colorBuffer(SdfPath()),
+      _depthBuffer(SdfPath()),
+      _delegate(delegate) {
     auto* universe = _delegate->GetUniverse();
+    _delegate->GetStats().NodeCreated(4);
     _camera = AiNode(universe, Str::persp_camera);
-    AiNodeSetPtr(AiUniverseGetOptions(universe), Str::camera, _camera);
     AiNodeSetStr(
         _camera, Str::name, _delegate->GetLocalNodeName(Str::renderPassCamera));
     _beautyFilter = AiNode(universe, Str::gaussian_filter);
@@ -70,18 +124,7 @@ HdAiRenderPass::HdAiRenderPass(
     _driver = AiNode(universe, HdAiNodeNames::driver);
     AiNodeSetStr(
         _driver, Str::name, _delegate->GetLocalNodeName(Str::renderPassDriver));
-    auto* options = _delegate->GetOptions();
-    auto* outputsArray = AiArrayAllocate(2, 1, AI_TYPE_STRING);
-    const auto beautyString = TfStringPrintf(
-        "RGBA RGBA %s %s", AiNodeGetName(_beautyFilter),
-        AiNodeGetName(_driver));
-    // We need NDC, and the easiest way is to use the position.
-    const auto positionString = TfStringPrintf(
-        "P VECTOR %s %s", AiNodeGetName(_closestFilter),
-        AiNodeGetName(_driver));
-    AiArraySetStr(outputsArray, 0, beautyString.c_str());
-    AiArraySetStr(outputsArray, 1, positionString.c_str());
-    AiNodeSetArray(options, Str::outputs, outputsArray);
+    AiNodeSetPtr(_driver, HdAiDriver::bucketQueue, &_bucketQueue);
 
     const auto& config = HdAiConfig::GetInstance();
     AiNodeSetFlt(_camera, Str::shutter_start, config.shutter_start);
@@ -89,10 +132,44 @@ HdAiRenderPass::HdAiRenderPass(
 }
 
 HdAiRenderPass::~HdAiRenderPass() {
+    _DebugBucketArenaStats(_bucketQueue.GetArena(), "~HdAiRenderPass");
+    // The driver pushes to the bucket queue owned by the render pass, so
+    // Arnold has to stop rendering before the queue goes away.
+    auto* renderParam =
+        reinterpret_cast<HdAiRenderParam*>(_delegate->GetRenderParam());
+    renderParam->End();
+    if (renderParam->GetActivePass() == this) {
+        auto* options = _delegate->GetOptions();
+        AiNodeSetPtr(options, Str::camera, nullptr);
+        AiNodeResetParameter(options, Str::outputs.c_str());
+        renderParam->ReleasePass(this);
+    }
     AiNodeDestroy(_camera);
     AiNodeDestroy(_beautyFilter);
     AiNodeDestroy(_closestFilter);
     AiNodeDestroy(_driver);
+    _delegate->GetStats().NodeDestroyed(4);
+    if (_colorTexture != 0) { glDeleteTextures(1, &_colorTexture); }
+    if (_depthTexture != 0) { glDeleteTextures(1, &_depthTexture); }
+}
+
+void HdAiRenderPass::_Activate() {
+    auto* options = _delegate->GetOptions();
+    AiNodeSetPtr(options, Str::camera, _camera);
+    auto* outputsArray = AiArrayAllocate(2, 1, AI_TYPE_STRING);
+    const auto beautyString = TfStringPrintf(
+        "RGBA RGBA %s %s", AiNodeGetName(_beautyFilter),
+        AiNodeGetName(_driver));
+    // The driver converts the camera space depth to NDC.
+    const auto depthString = TfStringPrintf(
+        "Z FLOAT %s %s", AiNodeGetName(_closestFilter), AiNodeGetName(_driver));
+    AiArraySetStr(outputsArray, 0, beautyString.c_str());
+    AiArraySetStr(outputsArray, 1, depthString.c_str());
+    AiNodeSetArray(options, Str::outputs, outputsArray);
+    if (_width > 0 && _height > 0) {
+        AiNodeSetInt(options, Str::xres, _width);
+        AiNodeSetInt(options, Str::yres, _height);
+    }
 }
 
 void HdAiRenderPass::_Execute(
@@ -101,91 +178,210 @@ void HdAiRenderPass::_Execute(
     auto* renderParam =
         reinterpret_cast<HdAiRenderParam*>(_delegate->GetRenderParam());
     const auto vp = renderPassState->GetViewport();
-
     const auto projMtx = renderPassState->GetProjectionMatrix();
     const auto viewMtx = renderPassState->GetWorldToViewMatrix();
-    auto restarted = false;
-    if (projMtx != _projMtx || viewMtx != _viewMtx) {
+    const auto width = static_cast<int>(vp[2]);
+    const auto height = static_cast<int>(vp[3]);
+    const auto cameraChanged = projMtx != _projMtx || viewMtx != _viewMtx;
+    const auto resized = width != _width || height != _height;
+
+    // Render passes sharing the delegate take turns rendering. An inactive
+    // pass keeps its last image while it's up to date, otherwise it waits
+    // for the active pass to finish and takes over the camera and outputs.
+    auto isActive = renderParam->GetActivePass() == this;
+    if (!isActive) {
+        const auto upToDate =
+            _isConverged && !cameraChanged && !resized &&
+            _sceneVersion == renderParam->GetSceneVersion();
+        if (!upToDate && renderParam->AcquirePass(this)) {
+            isActive = true;
+            _Activate();
+        } else {
+            _isConverged = upToDate;
+        }
+    }
+
+    auto interrupted = false;
+    if (isActive && cameraChanged) {
         _projMtx = projMtx;
         _viewMtx = viewMtx;
-        renderParam->Restart();
-        restarted = true;
+        renderParam->Interrupt(false);
+        interrupted = true;
         AiNodeSetMatrix(
             _camera, Str::matrix, HdAiConvertMatrix(_viewMtx.GetInverse()));
         AiNodeSetMatrix(
             _driver, HdAiDriver::projMtx, HdAiConvertMatrix(_projMtx));
-        AiNodeSetMatrix(
-            _driver, HdAiDriver::viewMtx, HdAiConvertMatrix(_viewMtx));
         const auto fov = static_cast<float>(
             GfRadiansToDegrees(atan(1.0 / _projMtx[0][0]) * 2.0));
         AiNodeSetFlt(_camera, Str::fov, fov);
     }
 
-    const auto width = static_cast<int>(vp[2]);
-    const auto height = static_cast<int>(vp[3]);
-    const auto numPixels = static_cast<size_t>(width * height);
-    if (width != _width || height != _height) {
-        if (!restarted) { renderParam->Restart(); }
-        hdAiEmptyBucketQueue([](const HdAiBucketData*) {});
-        const auto oldNumPixels = static_cast<size_t>(_width * _height);
+    if (isActive && resized) {
+        if (!interrupted) { renderParam->Interrupt(false); }
+        interrupted = true;
+        _bucketQueue.Empty([](const HdAiBucketData*) {});
         _width = width;
         _height = height;
 
         auto* options = _delegate->GetOptions();
         AiNodeSetInt(options, Str::xres, _width);
         AiNodeSetInt(options, Str::yres, _height);
+        _DebugBucketArenaStats(_bucketQueue.GetArena(), "_Execute");
+        _bucketQueue.GetArena().Reserve(
+            _width, _height, AiNodeGetInt(options, Str::bucket_size));
+    }
 
-        if (oldNumPixels < numPixels) {
-            _colorBuffer.resize(numPixels, AtRGBA8());
-            _depthBuffer.resize(numPixels, 1.0f);
-            memset(_colorBuffer.data(), 0, oldNumPixels * sizeof(AtRGBA8));
-            std::fill(
-                _depthBuffer.begin(), _depthBuffer.begin() + oldNumPixels,
-                1.0f);
-        } else {
-            if (numPixels != oldNumPixels) {
-                _colorBuffer.resize(numPixels);
-                _depthBuffer.resize(numPixels);
+    // When Hydra binds render buffers to the color and depth aovs, we write
+    // the buckets directly to them, otherwise we use our own buffers and draw
+    // them through the compositor.
+    const auto& aovBindings = renderPassState->GetAovBindings();
+    const auto useCompositor = aovBindings.empty();
+    HdAiRenderBuffer* colorBuffer = nullptr;
+    HdAiRenderBuffer* depthBuffer = nullptr;
+    if (useCompositor) {
+        colorBuffer = &_colorBuffer;
+        depthBuffer = &_depthBuffer;
+        if (_colorBuffer.GetWidth() != static_cast<unsigned int>(_width) ||
+            _colorBuffer.GetHeight() != static_cast<unsigned int>(_height)) {
+            const GfVec3i dimensions(_width, _height, 1);
+            _colorBuffer.Allocate(dimensions, HdFormatUNorm8Vec4, false);
+            _depthBuffer.Allocate(dimensions, HdFormatFloat32, false);
+            _colorBuffer.Clear(GfVec4f(0.0f));
+            _depthBuffer.Clear(GfVec4f(1.0f));
+        }
+    } else {
+        for (const auto& binding : aovBindings) {
+            auto* renderBuffer =
+                dynamic_cast<HdAiRenderBuffer*>(binding.renderBuffer);
+            if (renderBuffer == nullptr) { continue; }
+            if (binding.aovName == HdAovTokens->color) {
+                colorBuffer = renderBuffer;
+            } else if (binding.aovName == HdAovTokens->depth) {
+                depthBuffer = renderBuffer;
+            } else {
+                continue;
+            }
+            if (isActive && resized) {
+                const auto& clearValue = binding.clearValue;
+                if (clearValue.IsHolding<GfVec4f>()) {
+                    renderBuffer->Clear(clearValue.UncheckedGet<GfVec4f>());
+                } else if (clearValue.IsHolding<float>()) {
+                    renderBuffer->Clear(
+                        GfVec4f(clearValue.UncheckedGet<float>()));
+                }
             }
-            memset(_colorBuffer.data(), 0, numPixels * sizeof(AtRGBA8));
-            std::fill(_depthBuffer.begin(), _depthBuffer.end(), 1.0f);
         }
     }
 
-    _isConverged = renderParam->Render();
-    bool needsUpdate = false;
-    hdAiEmptyBucketQueue([this, &needsUpdate](const HdAiBucketData* data) {
-        const auto xo = AiClamp(data->xo, 0, _width - 1);
-        const auto xe = AiClamp(data->xo + data->sizeX, 0, _width - 1);
-        if (xe == xo) { return; }
-        const auto yo = AiClamp(data->yo, 0, _height - 1);
-        const auto ye = AiClamp(data->yo + data->sizeY, 0, _height - 1);
-        if (ye == yo) { return; }
-        needsUpdate = true;
-        const auto beautyWidth = (xe - xo) * sizeof(AtRGBA8);
-        const auto depthWidth = (xe - xo) * sizeof(float);
-        const auto inOffsetG = xo - data->xo - data->sizeX * data->yo;
-        const auto outOffsetG = _width * (_height - 1);
-        for (auto y = yo; y < ye; ++y) {
-            const auto inOffset = data->sizeX * y + inOffsetG;
-            const auto outOffset = xo + outOffsetG - _width * y;
-            memcpy(
-                _colorBuffer.data() + outOffset, data->beauty.data() + inOffset,
-                beautyWidth);
-            memcpy(
-                _depthBuffer.data() + outOffset, data->depth.data() + inOffset,
-                depthWidth);
+    // The compositor only accepts 8 bit colors, but bound render buffers
+    // receive the full precision output of Arnold when they can store it.
+    auto beautyFormat = HdAiBeautyFormat::UNorm8;
+    if (!useCompositor && colorBuffer != nullptr) {
+        const auto componentFormat =
+            HdGetComponentFormat(colorBuffer->GetFormat());
+        if (componentFormat == HdFormatFloat32) {
+            beautyFormat = HdAiBeautyFormat::Float32;
+        } else if (componentFormat == HdFormatFloat16) {
+            beautyFormat = HdAiBeautyFormat::Float16;
+        }
+    }
+    if (isActive && beautyFormat != _beautyFormat) {
+        if (!interrupted) { renderParam->Interrupt(false); }
+        _beautyFormat = beautyFormat;
+        AiNodeSetInt(
+            _driver, HdAiDriver::beautyFormat, static_cast<int>(_beautyFormat));
+    }
+
+    auto& stats = renderParam->GetStats();
+    if (isActive) {
+        // Not converged while textures are converted, so the host keeps
+        // drawing and the converted files are picked up.
+        _isConverged = renderParam->Render() &&
+                       !_delegate->GetTextureCache().HasPendingJobs();
+        if (_isConverged) { _sceneVersion = renderParam->GetSceneVersion(); }
+    }
+    _dirtyTiles.clear();
+    const auto drainStart = HdAiRenderStats::Clock::now();
+    _bucketQueue.Empty([&](const HdAiBucketData* data) {
+        if (useCompositor) {
+            // Render buffers are stored bottom-up, so the tile is flipped.
+            const auto xo = std::max(0, data->xo);
+            const auto xe = std::min(_width, data->xo + data->sizeX);
+            const auto yo = std::max(0, _height - data->yo - data->sizeY);
+            const auto ye = std::min(_height, _height - data->yo);
+            if (xe > xo && ye > yo) {
+                _dirtyTiles.emplace_back(GfVec2i(xo, yo), xe - xo, ye - yo);
+            }
+        }
+        if (colorBuffer != nullptr) {
+            colorBuffer->WriteBucket(
+                data->xo, data->yo, data->sizeX, data->sizeY,
+                _GetBeautyHdFormat(data->beautyFormat), data->beauty.data());
+        }
+        if (depthBuffer != nullptr) {
+            depthBuffer->WriteBucket(
+                data->xo, data->yo, data->sizeX, data->sizeY, HdFormatFloat32,
+                data->depth.data());
         }
     });
 
-    // If the buffers are empty, needsUpdate will be false.
-    if (needsUpdate) {
-        _compositor.UpdateColor(
-            _width, _height, reinterpret_cast<uint8_t*>(_colorBuffer.data()));
-        _compositor.UpdateDepth(
-            _width, _height, reinterpret_cast<uint8_t*>(_depthBuffer.data()));
+    if (colorBuffer != nullptr) { colorBuffer->SetConverged(_isConverged); }
+    if (depthBuffer != nullptr) { depthBuffer->SetConverged(_isConverged); }
+    stats.AddBucketDrainTime(drainStart);
+
+    if (!useCompositor) {
+        stats.EndFrame();
+        return;
+    }
+    const auto uploadStart = HdAiRenderStats::Clock::now();
+    // We upload to our own textures, so only the tiles that changed since the
+    // last frame are sent to the GPU, instead of the full frame.
+    _uploadedBytes = 0;
+    GLint restoreTexture = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &restoreTexture);
+    const auto* colorData = _colorBuffer.Map();
+    const auto* depthData = _depthBuffer.Map();
+    const auto numPixels = static_cast<size_t>(_width) * _height;
+    if (_textureWidth != _width || _textureHeight != _height) {
+        _textureWidth = _width;
+        _textureHeight = _height;
+        _AllocateTexture(
+            _colorTexture, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, _width, _height,
+            colorData);
+        _AllocateTexture(
+            _depthTexture, GL_R32F, GL_RED, GL_FLOAT, _width, _height,
+            depthData);
+        _uploadedBytes = numPixels * (sizeof(AtRGBA8) + sizeof(float));
+    } else if (!_dirtyTiles.empty()) {
+        size_t dirtyPixels = 0;
+        for (const auto& tile : _dirtyTiles) {
+            dirtyPixels += static_cast<size_t>(tile.GetArea());
+        }
+        // Overlapping buckets can add up to more than the frame.
+        if (dirtyPixels >= numPixels) {
+            _dirtyTiles.assign(1, GfRect2i(GfVec2i(0, 0), _width, _height));
+            dirtyPixels = numPixels;
+        }
+        glBindTexture(GL_TEXTURE_2D, _colorTexture);
+        for (const auto& tile : _dirtyTiles) {
+            _UploadTile(tile, _width, GL_RGBA, GL_UNSIGNED_BYTE, colorData);
+        }
+        glBindTexture(GL_TEXTURE_2D, _depthTexture);
+        for (const auto& tile : _dirtyTiles) {
+            _UploadTile(tile, _width, GL_RED, GL_FLOAT, depthData);
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        _uploadedBytes = dirtyPixels * (sizeof(AtRGBA8) + sizeof(float));
     }
-    _compositor.Draw();
+    _colorBuffer.Unmap();
+    _depthBuffer.Unmap();
+    glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(restoreTexture));
+    _compositor.Draw(_colorTexture, _depthTexture, false);
+    stats.AddUploadTime(uploadStart);
+    stats.AddUploadedBytes(_uploadedBytes);
+    stats.EndFrame();
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -18,10 +18,12 @@
 #include "pxr/imaging/hdAi/api.h"
 
 #include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/rect2i.h>
 #include <pxr/imaging/hd/renderPass.h>
 #include <pxr/imaging/hdx/compositor.h>
 
 #include "pxr/imaging/hdAi/nodes/nodes.h"
+#include "pxr/imaging/hdAi/renderBuffer.h"
 #include "pxr/imaging/hdAi/renderDelegate.h"
 
 #include <ai.h>
@@ -39,6 +41,10 @@ public:
 
     bool IsConverged() const { return _isConverged; }
 
+    /// Returns the number of bytes uploaded to the compositor textures in the
+    /// last frame.
+    size_t GetUploadedBytes() const { return _uploadedBytes; }
+
 protected:
     HDAI_API
     void _Execute(
@@ -46,8 +52,15 @@ protected:
         const TfTokenVector& renderTags) override;
 
 private:
-    std::vector<AtRGBA8> _colorBuffer;
-    std::vector<float> _depthBuffer;
+    /// Writes the camera, the outputs and the resolution of the render pass to
+    /// the options, when it becomes the active pass.
+    void _Activate();
+
+    // Used when Hydra doesn't bind any render buffers to the render pass and
+    // we are drawing through the compositor.
+    HdAiRenderBuffer _colorBuffer;
+    HdAiRenderBuffer _depthBuffer;
+    HdAiBucketQueue _bucketQueue;
     HdAiRenderDelegate* _delegate;
     AtNode* _camera = nullptr;
     AtNode* _beautyFilter = nullptr;
@@ -55,12 +68,22 @@ private:
     AtNode* _driver = nullptr;
 
     HdxCompositor _compositor;
+    std::vector<GfRect2i> _dirtyTiles;
+    size_t _uploadedBytes = 0;
+    GLuint _colorTexture = 0;
+    GLuint _depthTexture = 0;
+    int _textureWidth = 0;
+    int _textureHeight = 0;
 
     GfMatrix4d _viewMtx;
     GfMatrix4d _projMtx;
 
     int _width = 0;
     int _height = 0;
+    // Scene version of the last finished render.
+    size_t _sceneVersion = 0;
+
+    HdAiBeautyFormat _beautyFormat = HdAiBeautyFormat::UNorm8;
 
     bool _isConverged = false;
 };
@@ -0,0 +1,100 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/renderStats.h"
+
+#include <pxr/base/tf/staticTokens.h>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_PRIVATE_TOKENS(
+    _tokens,
+    (frame)(syncTime)(renderTime)(bucketDrainTime)(uploadTime)(uploadedBytes)(
+        weldTime)(nodesCreated)(nodesDestroyed)(renderRestarts));
+
+double HdAiRenderStats::_Elapsed(const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+void HdAiRenderStats::AddSyncTime(
+    const TfToken& primType, const Clock::time_point& start) {
+    const auto elapsed = _Elapsed(start);
+    std::lock_guard<std::mutex> guard(_mutex);
+    _current.syncTimes[primType] += elapsed;
+}
+
+void HdAiRenderStats::AddRenderTime(double milliseconds) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _current.renderTime += milliseconds;
+}
+
+void HdAiRenderStats::AddBucketDrainTime(const Clock::time_point& start) {
+    const auto elapsed = _Elapsed(start);
+    std::lock_guard<std::mutex> guard(_mutex);
+    _current.bucketDrainTime += elapsed;
+}
+
+void HdAiRenderStats::AddUploadTime(const Clock::time_point& start) {
+    const auto elapsed = _Elapsed(start);
+    std::lock_guard<std::mutex> guard(_mutex);
+    _current.uploadTime += elapsed;
+}
+
+void HdAiRenderStats::AddUploadedBytes(size_t bytes) {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _current.uploadedBytes += bytes;
+}
+
+void HdAiRenderStats::AddWeldTime(const Clock::time_point& start) {
+    const auto elapsed = _Elapsed(start);
+    std::lock_guard<std::mutex> guard(_mutex);
+    _current.weldTime += elapsed;
+}
+
+void HdAiRenderStats::EndFrame() {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _last = std::move(_current);
+    _current = FrameStats();
+    _lastNodesCreated = _nodesCreated.exchange(0);
+    _lastNodesDestroyed = _nodesDestroyed.exchange(0);
+    _lastRenderRestarts = _renderRestarts.exchange(0);
+    ++_frame;
+}
+
+VtDictionary HdAiRenderStats::GetStats() const {
+    std::lock_guard<std::mutex> guard(_mutex);
+    VtDictionary stats;
+    VtDictionary syncTimes;
+    for (const auto& it : _last.syncTimes) {
+        syncTimes[it.first.GetString()] = VtValue(it.second);
+    }
+    stats[_tokens->frame.GetString()] = VtValue(static_cast<int64_t>(_frame));
+    stats[_tokens->syncTime.GetString()] = VtValue(syncTimes);
+    stats[_tokens->renderTime.GetString()] = VtValue(_last.renderTime);
+    stats[_tokens->bucketDrainTime.GetString()] =
+        VtValue(_last.bucketDrainTime);
+    stats[_tokens->uploadTime.GetString()] = VtValue(_last.uploadTime);
+    stats[_tokens->uploadedBytes.GetString()] =
+        VtValue(static_cast<int64_t>(_last.uploadedBytes));
+    stats[_tokens->weldTime.GetString()] = VtValue(_last.weldTime);
+    stats[_tokens->nodesCreated.GetString()] =
+        VtValue(static_cast<int64_t>(_lastNodesCreated));
+    stats[_tokens->nodesDestroyed.GetString()] =
+        VtValue(static_cast<int64_t>(_lastNodesDestroyed));
+    stats[_tokens->renderRestarts.GetString()] =
+        VtValue(static_cast<int64_t>(_lastRenderRestarts));
+    return stats;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,104 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_RENDER_STATS_H
+#define HDAI_RENDER_STATS_H
+
+#include <pxr/pxr.h>
+#include "pxr/imaging/hdAi/api.h"
+
+#include <pxr/base/tf/token.h>
+#include <pxr/base/vt/dictionary.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Collects where the interactive time goes, so hosts can chart it through
+/// HdRenderDelegate::GetRenderStats. Values are accumulated during a frame and
+/// published when the render pass calls EndFrame. All the functions are safe to
+/// call from multiple threads.
+class HdAiRenderStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Adds the time elapsed during its lifetime to the sync time of a prim
+    /// type.
+    class SyncTimer {
+    public:
+        SyncTimer(HdAiRenderStats& stats, const TfToken& primType)
+            : _stats(stats), _primType(primType), _start(Clock::now()) {}
+        ~SyncTimer() { _stats.AddSyncTime(_primType, _start); }
+
+    private:
+        HdAiRenderStats& _stats;
+        TfToken _primType;
+        Clock::time_point _start;
+    };
+
+    HDAI_API
+    void AddSyncTime(const TfToken& primType, const Clock::time_point& start);
+    HDAI_API
+    void AddRenderTime(double milliseconds);
+    HDAI_API
+    void AddBucketDrainTime(const Clock::time_point& start);
+    HDAI_API
+    void AddUploadTime(const Clock::time_point& start);
+    HDAI_API
+    void AddUploadedBytes(size_t bytes);
+    HDAI_API
+    void AddWeldTime(const Clock::time_point& start);
+
+    void NodeCreated(size_t count = 1) { _nodesCreated.fetch_add(count); }
+    void NodeDestroyed(size_t count = 1) { _nodesDestroyed.fetch_add(count); }
+    void RenderRestarted() { _renderRestarts.fetch_add(1); }
+
+    /// Publishes the values collected since the last call and starts a new
+    /// frame.
+    HDAI_API
+    void EndFrame();
+
+    /// Returns the values of the last frame.
+    HDAI_API
+    VtDictionary GetStats() const;
+
+private:
+    static double _Elapsed(const Clock::time_point& start);
+
+    struct FrameStats {
+        std::unordered_map<TfToken, double, TfToken::HashFunctor> syncTimes;
+        double renderTime = 0.0;
+        double bucketDrainTime = 0.0;
+        double uploadTime = 0.0;
+        size_t uploadedBytes = 0;
+        double weldTime = 0.0;
+    };
+
+    mutable std::mutex _mutex;
+    FrameStats _current;
+    FrameStats _last;
+    std::atomic<size_t> _nodesCreated{0};
+    std::atomic<size_t> _nodesDestroyed{0};
+    std::atomic<size_t> _renderRestarts{0};
+    size_t _lastNodesCreated = 0;
+    size_t _lastNodesDestroyed = 0;
+    size_t _lastRenderRestarts = 0;
+    size_t _frame = 0;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_RENDER_STATS_H
@@ -0,0 +1,80 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/shaderRegistry.h"
+
+#include <pxr/base/tf/staticTokens.h>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+TF_DEFINE_PRIVATE_TOKENS(
+    _tokens, (sharedShaderNodes)(sharedShaderReferences)(sharedShaderSaved));
+
+HdAiShaderRegistry::HdAiShaderRegistry(HdAiRenderStats& stats)
+    : _stats(stats) {}
+
+HdAiShaderRegistry::~HdAiShaderRegistry() {
+    for (auto& entry : _entries) { AiNodeDestroy(entry.second.node); }
+    _stats.NodeDestroyed(_entries.size());
+}
+
+AtNode* HdAiShaderRegistry::Acquire(size_t hash) {
+    auto it = _entries.find(hash);
+    if (it == _entries.end()) { return nullptr; }
+    it->second.refCount += 1;
+    return it->second.node;
+}
+
+void HdAiShaderRegistry::Insert(size_t hash, AtNode* node) {
+    _entries[hash] = {node, 1};
+}
+
+void HdAiShaderRegistry::Release(size_t hash) {
+    auto it = _entries.find(hash);
+    if (it == _entries.end()) { return; }
+    if (--it->second.refCount == 0) {
+        AiNodeDestroy(it->second.node);
+        _stats.NodeDestroyed();
+        _entries.erase(it);
+    }
+}
+
+bool HdAiShaderRegistry::IsUnique(size_t hash) const {
+    const auto it = _entries.find(hash);
+    return it != _entries.end() && it->second.refCount == 1;
+}
+
+void HdAiShaderRegistry::Rekey(size_t from, size_t to) {
+    auto it = _entries.find(from);
+    if (it == _entries.end()) { return; }
+    const auto entry = it->second;
+    _entries.erase(it);
+    _entries[to] = entry;
+}
+
+VtDictionary HdAiShaderRegistry::GetStats() const {
+    size_t numReferences = 0;
+    for (const auto& entry : _entries) {
+        numReferences += entry.second.refCount;
+    }
+    VtDictionary stats;
+    stats[_tokens->sharedShaderNodes.GetString()] =
+        VtValue(static_cast<int64_t>(_entries.size()));
+    stats[_tokens->sharedShaderReferences.GetString()] =
+        VtValue(static_cast<int64_t>(numReferences));
+    stats[_tokens->sharedShaderSaved.GetString()] =
+        VtValue(static_cast<int64_t>(numReferences - _entries.size()));
+    return stats;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
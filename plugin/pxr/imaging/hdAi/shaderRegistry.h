@@ -0,0 +1,86 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_SHADER_REGISTRY_H
+#define HDAI_SHADER_REGISTRY_H
+
+#include <pxr/pxr.h>
+#include "pxr/imaging/hdAi/api.h"
+
+#include <pxr/base/vt/dictionary.h>
+
+#include "pxr/imaging/hdAi/renderStats.h"
+
+#include <ai.h>
+
+#include <unordered_map>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Shares identical shader subgraphs between materials.
+///
+/// Materials key the shader nodes feeding their terminal node by the hash of
+/// the subgraph ending in the node, which covers the node type, its
+/// parameters and the hashes of its inputs. Materials with the same subgraph
+/// reference the same Arnold node, and the node is destroyed when the last
+/// reference is released.
+///
+/// Materials are synced serially, so the registry is not thread-safe.
+class HdAiShaderRegistry {
+public:
+    HDAI_API
+    explicit HdAiShaderRegistry(HdAiRenderStats& stats);
+    HDAI_API
+    ~HdAiShaderRegistry();
+
+    /// Returns the node of \p hash and adds a reference to it, or nullptr if
+    /// there is no such node.
+    HDAI_API
+    AtNode* Acquire(size_t hash);
+
+    /// Adds \p node as the node of \p hash, with a single reference.
+    HDAI_API
+    void Insert(size_t hash, AtNode* node);
+
+    /// Removes a reference from the node of \p hash, and destroys the node
+    /// if it was the last one.
+    HDAI_API
+    void Release(size_t hash);
+
+    /// Returns true if the node of \p hash is only referenced once, so it can
+    /// be edited in place.
+    HDAI_API
+    bool IsUnique(size_t hash) const;
+
+    /// Moves the node of \p from to \p to, which must not be registered.
+    HDAI_API
+    void Rekey(size_t from, size_t to);
+
+    /// Returns the number of shader nodes, the number of references to them,
+    /// which is the number of nodes without sharing, and their difference.
+    HDAI_API
+    VtDictionary GetStats() const;
+
+private:
+    struct Entry {
+        AtNode* node;
+        size_t refCount;
+    };
+
+    HdAiRenderStats& _stats;
+    std::unordered_map<size_t, Entry> _entries;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_SHADER_REGISTRY_H
@@ -0,0 +1,36 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_TEST_BENCHMARK_H
+#define HDAI_TEST_BENCHMARK_H
+
+#include <chrono>
+#include <cstdio>
+
+/// Returns the average time in milliseconds of \p iterations calls to \p f.
+template <typename F>
+double hdAiTestTime(size_t iterations, F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) { f(); }
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+               .count() /
+           static_cast<double>(iterations);
+}
+
+/// Prints a timing, so the results of a run can be compared by hand.
+inline void hdAiTestReport(const char* name, double ms) {
+    printf("[ TIMING   ] %s: %.4f ms\n", name, ms);
+}
+
+#endif // HDAI_TEST_BENCHMARK_H
@@ -0,0 +1,79 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "testHdAiBenchmark.h"
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr int numStrands = 5000000;
+constexpr int numStrandPoints = 6;
+
+/// Syncs a groom of 5M strands with per vertex widths, and reports
+/// the time and the memory allocated by Arnold.
+void _SyncCurves(const TfToken& type, const TfToken& basis, const char* name) {
+    HdAiTestScene scene;
+    const SdfPath id("/curves");
+    auto& curves = scene.delegate.AddRprim(HdPrimTypeTokens->basisCurves, id);
+    curves.curvesTopology = HdBasisCurvesTopology(
+        type, basis, HdTokens->nonperiodic,
+        VtIntArray(numStrands, numStrandPoints), VtIntArray());
+    const auto numPoints = static_cast<size_t>(numStrands) * numStrandPoints;
+    VtVec3fArray points(numPoints);
+    VtFloatArray widths(numPoints);
+    for (size_t i = 0; i < numPoints; ++i) {
+        const auto strand = static_cast<float>(i / numStrandPoints);
+        const auto height = static_cast<float>(i % numStrandPoints);
+        points[i] = GfVec3f(strand * 0.01f, height * 0.1f, 0.0f);
+        widths[i] = 0.01f * (numStrandPoints - height) / numStrandPoints;
+    }
+    scene.delegate.SetPrimvar(
+        id, HdTokens->points, VtValue(points), HdInterpolationVertex,
+        HdPrimvarRoleTokens->point);
+    scene.delegate.SetPrimvar(
+        id, HdTokens->widths, VtValue(widths), HdInterpolationVertex);
+
+    const auto memoryBefore = AiMsgUtilGetUsedMemory();
+    const auto ms = hdAiTestTime(1, [&]() {
+        scene.delegate.SyncRprim(id);
+        scene.Commit();
+    });
+    const auto usedMemory =
+        static_cast<double>(AiMsgUtilGetUsedMemory() - memoryBefore) /
+        (1024.0 * 1024.0);
+    hdAiTestReport(
+        TfStringPrintf("5M strands, %s, sync and commit", name).c_str(), ms);
+    printf(
+        "[ MEMORY   ] 5M strands, %s: %.1f MiB, %.1f bytes per point\n", name,
+        usedMemory, usedMemory * 1024.0 * 1024.0 / numPoints);
+}
+
+} // namespace
+
+// The per vertex widths are remapped to the segment end points of each
+// strand, which are every point for linear curves, and fewer for the cubic
+// bases.
+TEST(HdAiCurvesBenchmark, FiveMillionStrands) {
+    _SyncCurves(HdTokens->linear, HdTokens->bSpline, "linear");
+    _SyncCurves(HdTokens->cubic, HdTokens->bSpline, "cubic b-spline");
+    _SyncCurves(HdTokens->cubic, HdTokens->catmullRom, "cubic catmull-rom");
+}
@@ -0,0 +1,355 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_TEST_DELEGATE_H
+#define HDAI_TEST_DELEGATE_H
+
+#include <pxr/pxr.h>
+
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/imaging/hd/basisCurvesTopology.h>
+#include <pxr/imaging/hd/changeTracker.h>
+#include <pxr/imaging/hd/instancer.h>
+#include <pxr/imaging/hd/meshTopology.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/renderPassState.h>
+#include <pxr/imaging/hd/rprim.h>
+#include <pxr/imaging/hd/sceneDelegate.h>
+#include <pxr/imaging/hd/sprim.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/pxOsd/tokens.h>
+
+#include "pxr/imaging/hdAi/renderBuffer.h"
+#include "pxr/imaging/hdAi/renderDelegate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/// Scene delegate serving prims from in-memory tables, so the hdAi prims can
+/// be synced and rendered without a stage.
+class HdAiTestDelegate final : public HdSceneDelegate {
+public:
+    struct Primvar {
+        VtValue value;
+        HdInterpolation interpolation = HdInterpolationConstant;
+        TfToken role;
+        /// Time samples returned by SamplePrimvar, when not empty.
+        std::vector<float> times;
+        std::vector<VtValue> samples;
+    };
+
+    struct Prim {
+        HdMeshTopology meshTopology;
+        HdBasisCurvesTopology curvesTopology;
+        GfMatrix4d transform{1.0};
+        bool visible = true;
+        SdfPath materialId;
+        VtArray<TfToken> categories;
+        std::map<TfToken, Primvar> primvars;
+        std::map<TfToken, VtValue> params;
+        VtValue materialResource;
+        /// Instance indices of each prototype, for instancers.
+        std::map<SdfPath, VtIntArray> instanceIndices;
+    };
+
+    HdAiTestDelegate(HdRenderIndex* index)
+        : HdSceneDelegate(index, SdfPath::AbsoluteRootPath()) {}
+
+    Prim& AddRprim(
+        const TfToken& type, const SdfPath& id,
+        const SdfPath& instancerId = SdfPath()) {
+        GetRenderIndex().InsertRprim(type, this, id, instancerId);
+        return _prims[id];
+    }
+
+    Prim& AddSprim(const TfToken& type, const SdfPath& id) {
+        GetRenderIndex().InsertSprim(type, this, id);
+        return _prims[id];
+    }
+
+    Prim& AddInstancer(const SdfPath& id, const SdfPath& parentId = SdfPath()) {
+        GetRenderIndex().InsertInstancer(this, id, parentId);
+        return _prims[id];
+    }
+
+    /// Adds a two by two quad mesh facing +Z, centered at the origin.
+    Prim& AddQuad(const SdfPath& id, const SdfPath& instancerId = SdfPath()) {
+        auto& quad = AddRprim(HdPrimTypeTokens->mesh, id, instancerId);
+        quad.meshTopology = HdMeshTopology(
+            PxOsdOpenSubdivTokens->none, HdTokens->rightHanded,
+            VtIntArray{4}, VtIntArray{0, 1, 2, 3});
+        SetPrimvar(
+            id, HdTokens->points,
+            VtValue(VtVec3fArray{GfVec3f(-1.0f, -1.0f, 0.0f),
+                                 GfVec3f(1.0f, -1.0f, 0.0f),
+                                 GfVec3f(1.0f, 1.0f, 0.0f),
+                                 GfVec3f(-1.0f, 1.0f, 0.0f)}),
+            HdInterpolationVertex, HdPrimvarRoleTokens->point);
+        return quad;
+    }
+
+    /// Adds a grid of \p size by \p size quads in the XY plane, two units
+    /// wide and centered at the origin.
+    Prim& AddGrid(
+        const SdfPath& id, int size, const SdfPath& instancerId = SdfPath()) {
+        auto& grid = AddRprim(HdPrimTypeTokens->mesh, id, instancerId);
+        const auto numVerts = (size + 1) * (size + 1);
+        VtVec3fArray points(numVerts);
+        for (auto i = 0; i < numVerts; ++i) {
+            points[i] = GfVec3f(
+                2.0f * (i % (size + 1)) / size - 1.0f,
+                2.0f * (i / (size + 1)) / size - 1.0f, 0.0f);
+        }
+        VtIntArray faceVertexCounts(size * size, 4);
+        VtIntArray faceVertexIndices(size * size * 4);
+        for (auto face = 0; face < size * size; ++face) {
+            const auto v = face / size * (size + 1) + face % size;
+            faceVertexIndices[face * 4] = v;
+            faceVertexIndices[face * 4 + 1] = v + 1;
+            faceVertexIndices[face * 4 + 2] = v + size + 2;
+            faceVertexIndices[face * 4 + 3] = v + size + 1;
+        }
+        grid.meshTopology = HdMeshTopology(
+            PxOsdOpenSubdivTokens->none, HdTokens->rightHanded,
+            faceVertexCounts, faceVertexIndices);
+        SetPrimvar(
+            id, HdTokens->points, VtValue(points), HdInterpolationVertex,
+            HdPrimvarRoleTokens->point);
+        return grid;
+    }
+
+    Prim& GetPrim(const SdfPath& id) { return _prims[id]; }
+
+    void SetPrimvar(
+        const SdfPath& id, const TfToken& name, const VtValue& value,
+        HdInterpolation interpolation, const TfToken& role = TfToken()) {
+        auto& primvar = _prims[id].primvars[name];
+        primvar.value = value;
+        primvar.interpolation = interpolation;
+        primvar.role = role;
+    }
+
+    /// Syncs the rprim \p id, as if \p dirtyBits were set by the scene.
+    void SyncRprim(const SdfPath& id, HdDirtyBits dirtyBits) {
+        auto* rprim = const_cast<HdRprim*>(GetRenderIndex().GetRprim(id));
+        rprim->Sync(
+            this, GetRenderIndex().GetRenderDelegate()->GetRenderParam(),
+            &dirtyBits, HdReprTokens->hull);
+    }
+
+    /// Syncs the rprim \p id with all its dirty bits set, like the first
+    /// sync.
+    void SyncRprim(const SdfPath& id) {
+        SyncRprim(id, HdChangeTracker::AllDirty);
+    }
+
+    /// Syncs the sprim \p id, as if \p dirtyBits were set by the scene.
+    void SyncSprim(
+        const TfToken& type, const SdfPath& id, HdDirtyBits dirtyBits) {
+        auto* sprim = GetRenderIndex().GetSprim(type, id);
+        sprim->Sync(
+            this, GetRenderIndex().GetRenderDelegate()->GetRenderParam(),
+            &dirtyBits);
+    }
+
+    /// Syncs the sprim \p id with all its initial dirty bits.
+    void SyncSprim(const TfToken& type, const SdfPath& id) {
+        SyncSprim(
+            type, id,
+            GetRenderIndex().GetSprim(type, id)->GetInitialDirtyBitsMask());
+    }
+
+    HdMeshTopology GetMeshTopology(const SdfPath& id) override {
+        return _prims[id].meshTopology;
+    }
+
+    HdBasisCurvesTopology GetBasisCurvesTopology(const SdfPath& id) override {
+        return _prims[id].curvesTopology;
+    }
+
+    GfMatrix4d GetTransform(const SdfPath& id) override {
+        return _prims[id].transform;
+    }
+
+    bool GetVisible(const SdfPath& id) override { return _prims[id].visible; }
+
+    VtValue Get(const SdfPath& id, const TfToken& key) override {
+        const auto& primvars = _prims[id].primvars;
+        const auto it = primvars.find(key);
+        return it == primvars.end() ? VtValue() : it->second.value;
+    }
+
+    size_t SamplePrimvar(
+        const SdfPath& id, const TfToken& key, size_t maxSampleCount,
+        float* sampleTimes, VtValue* sampleValues) override {
+        const auto& primvars = _prims[id].primvars;
+        const auto it = primvars.find(key);
+        if (it == primvars.end() || it->second.times.empty()) {
+            return HdSceneDelegate::SamplePrimvar(
+                id, key, maxSampleCount, sampleTimes, sampleValues);
+        }
+        const auto& primvar = it->second;
+        const auto numSamples = primvar.times.size();
+        for (size_t i = 0; i < std::min(numSamples, maxSampleCount); ++i) {
+            sampleTimes[i] = primvar.times[i];
+            sampleValues[i] = primvar.samples[i];
+        }
+        return numSamples;
+    }
+
+    HdPrimvarDescriptorVector GetPrimvarDescriptors(
+        const SdfPath& id, HdInterpolation interpolation) override {
+        HdPrimvarDescriptorVector descriptors;
+        for (const auto& primvar : _prims[id].primvars) {
+            if (primvar.second.interpolation == interpolation) {
+                descriptors.emplace_back(
+                    primvar.first, interpolation, primvar.second.role);
+            }
+        }
+        return descriptors;
+    }
+
+    SdfPath GetMaterialId(const SdfPath& id) override {
+        return _prims[id].materialId;
+    }
+
+    VtValue GetMaterialResource(const SdfPath& id) override {
+        return _prims[id].materialResource;
+    }
+
+    VtValue GetLightParamValue(
+        const SdfPath& id, const TfToken& paramName) override {
+        const auto& params = _prims[id].params;
+        const auto it = params.find(paramName);
+        return it == params.end() ? VtValue() : it->second;
+    }
+
+    VtArray<TfToken> GetCategories(const SdfPath& id) override {
+        return _prims[id].categories;
+    }
+
+    VtIntArray GetInstanceIndices(
+        const SdfPath& instancerId, const SdfPath& prototypeId) override {
+        const auto& indices = _prims[instancerId].instanceIndices;
+        const auto it = indices.find(prototypeId);
+        return it == indices.end() ? VtIntArray() : it->second;
+    }
+
+private:
+    std::map<SdfPath, Prim> _prims;
+};
+
+/// Owns a render delegate, and a render index populated by a test delegate.
+struct HdAiTestScene {
+    HdAiTestScene()
+        : renderIndex(HdRenderIndex::New(&renderDelegate)),
+          delegate(renderIndex.get()) {}
+
+    // The prims are destroyed before the scene delegate they point to.
+    ~HdAiTestScene() { renderIndex.reset(); }
+
+    HdAiRenderParam& GetRenderParam() {
+        return *reinterpret_cast<HdAiRenderParam*>(
+            renderDelegate.GetRenderParam());
+    }
+
+    /// Runs the staged writes, like Hydra after syncing the prims.
+    void Commit() {
+        renderDelegate.CommitResources(&renderIndex->GetChangeTracker());
+    }
+
+    HdAiRenderDelegate renderDelegate;
+    std::unique_ptr<HdRenderIndex> renderIndex;
+    HdAiTestDelegate delegate;
+};
+
+/// A render pass with its own camera, writing the beauty to a float render
+/// buffer.
+struct HdAiTestRenderPass {
+    /// Pixels of the buffer are set to this before the first render.
+    static GfVec4f GetClearValue() { return GfVec4f(-1.0f); }
+
+    HdAiTestRenderPass(
+        HdAiTestScene& scene, int width, int height,
+        const GfMatrix4d& cameraXform)
+        : buffer(SdfPath("/buffer")) {
+        pass = scene.renderDelegate.CreateRenderPass(
+            scene.renderIndex.get(),
+            HdRprimCollection(
+                HdTokens->geometry, HdReprSelector(HdReprTokens->hull)));
+        buffer.Allocate(GfVec3i(width, height, 1), HdFormatFloat32Vec4, false);
+        state.reset(new HdRenderPassState());
+        SetCamera(cameraXform);
+        HdRenderPassAovBinding binding;
+        binding.aovName = HdAovTokens->color;
+        binding.clearValue = VtValue(GetClearValue());
+        binding.renderBuffer = &buffer;
+        state->SetAovBindings({binding});
+    }
+
+    void SetCamera(const GfMatrix4d& cameraXform) {
+        const auto width = buffer.GetWidth();
+        const auto height = buffer.GetHeight();
+        GfFrustum frustum;
+        frustum.SetPerspective(
+            60.0, static_cast<double>(width) / height, 0.1, 100.0);
+        state->SetCameraFramingState(
+            cameraXform.GetInverse(), frustum.ComputeProjectionMatrix(),
+            GfVec4d(0.0, 0.0, width, height),
+            HdRenderPassState::ClipPlanesVector());
+    }
+
+    void Execute() { pass->Execute(state, TfTokenVector()); }
+
+    bool IsConverged() const { return buffer.IsConverged(); }
+
+    std::vector<GfVec4f> GetPixels() {
+        const auto* pixels = reinterpret_cast<const GfVec4f*>(buffer.Map());
+        std::vector<GfVec4f> ret(
+            pixels, pixels + buffer.GetWidth() * buffer.GetHeight());
+        buffer.Unmap();
+        return ret;
+    }
+
+    HdRenderPassSharedPtr pass;
+    HdAiRenderBuffer buffer;
+    HdRenderPassStateSharedPtr state;
+};
+
+/// Executes \p passes until all of them converged, returns false if they
+/// didn't before \p timeout.
+inline bool hdAiTestRenderUntilConverged(
+    const std::vector<HdAiTestRenderPass*>& passes,
+    std::chrono::steady_clock::time_point timeout) {
+    while (std::chrono::steady_clock::now() < timeout) {
+        auto converged = true;
+        for (auto* pass : passes) {
+            pass->Execute();
+            converged = converged && pass->IsConverged();
+        }
+        if (converged) { return true; }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_TEST_DELEGATE_H
@@ -0,0 +1,139 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/nodes/nodes.h"
+
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/half.h>
+#include <pxr/base/gf/matrix4f.h>
+
+#include "testHdAiBenchmark.h"
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr int bucketSize = 64;
+constexpr size_t numPixels = bucketSize * bucketSize;
+constexpr size_t numIterations = 2000;
+
+std::vector<AtRGBA> _GenerateBucket() {
+    std::mt19937 gen(42);
+    // Values above one, like an HDR render.
+    std::uniform_real_distribution<float> dist(0.0f, 4.0f);
+    std::vector<AtRGBA> bucket(numPixels);
+    for (auto& pixel : bucket) {
+        pixel = AtRGBA(dist(gen), dist(gen), dist(gen), 1.0f);
+    }
+    return bucket;
+}
+
+double _TimeConversion(
+    HdAiBeautyFormat format, const std::vector<AtRGBA>& in,
+    std::vector<uint8_t>& out) {
+    out.resize(numPixels * hdAiGetBeautyPixelSize(format));
+    return hdAiTestTime(numIterations, [&]() {
+        hdAiConvertBeautyBucket(
+            in.data(), out.data(), format, 0, 0, bucketSize, bucketSize);
+    });
+}
+
+} // namespace
+
+TEST(HdAiDriverBenchmark, BeautyBucket) {
+    AiBegin();
+    AiMsgSetConsoleFlags(AI_LOG_NONE);
+    const auto in = _GenerateBucket();
+    std::vector<uint8_t> out;
+
+    hdAiTestReport(
+        "64x64 bucket, 8 bit quantized",
+        _TimeConversion(HdAiBeautyFormat::UNorm8, in, out));
+
+    hdAiTestReport(
+        "64x64 bucket, half float",
+        _TimeConversion(HdAiBeautyFormat::Float16, in, out));
+    const auto* halves = reinterpret_cast<const GfHalf*>(out.data());
+    for (size_t i = 0; i < numPixels; ++i) {
+        EXPECT_NEAR(float(halves[i * 4]), in[i].r, in[i].r * 1e-3f);
+        EXPECT_EQ(float(halves[i * 4 + 3]), in[i].a);
+    }
+
+    hdAiTestReport(
+        "64x64 bucket, float",
+        _TimeConversion(HdAiBeautyFormat::Float32, in, out));
+    const auto* floats = reinterpret_cast<const AtRGBA*>(out.data());
+    for (size_t i = 0; i < numPixels; ++i) { EXPECT_EQ(floats[i], in[i]); }
+    AiEnd();
+}
+
+// Compares the Z AOV path with the previous P AOV path, which transformed
+// every position by the view and the projection matrices.
+TEST(HdAiDriverBenchmark, DepthBucket) {
+    GfFrustum frustum;
+    frustum.SetPerspective(60.0, 1.0, 0.1, 100.0);
+    const GfMatrix4f projMtx(frustum.ComputeProjectionMatrix());
+    const GfMatrix4f viewMtx(
+        GfMatrix4d(1.0).SetTranslate(GfVec3d(0.0, 0.0, -5.0)));
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-2.0f, 2.0f);
+    std::vector<GfVec3f> positions(numPixels);
+    std::vector<float> depths(numPixels);
+    for (size_t i = 0; i < numPixels; ++i) {
+        positions[i] = GfVec3f(dist(gen), dist(gen), dist(gen));
+        depths[i] = -viewMtx.Transform(positions[i])[2];
+    }
+
+    std::vector<float> expected(numPixels);
+    hdAiTestReport(
+        "64x64 bucket, P with view and projection matrices",
+        hdAiTestTime(numIterations, [&]() {
+            for (size_t i = 0; i < numPixels; ++i) {
+                const auto p =
+                    projMtx.Transform(viewMtx.Transform(positions[i]));
+                expected[i] = std::max(-1.0f, std::min(1.0f, p[2]));
+            }
+        }));
+
+    HdAiDepthConversion conversion;
+    conversion.a = -projMtx[2][2];
+    conversion.b = projMtx[3][2];
+    conversion.c = -projMtx[2][3];
+    conversion.d = projMtx[3][3];
+    std::vector<float> result(numPixels);
+    hdAiTestReport(
+        "64x64 bucket, Z with fused NDC conversion",
+        hdAiTestTime(numIterations, [&]() {
+            for (auto y = 0; y < bucketSize; ++y) {
+                hdAiConvertDepthRow(
+                    conversion, depths.data() + y * bucketSize,
+                    result.data() + y * bucketSize, bucketSize);
+            }
+        }));
+    printf(
+        "[ TIMING   ] depth payload per bucket: P %zu bytes, Z %zu bytes\n",
+        numPixels * sizeof(GfVec3f), numPixels * sizeof(float));
+
+    for (size_t i = 0; i < numPixels; ++i) {
+        EXPECT_NEAR(result[i], expected[i], 1e-4f);
+    }
+}
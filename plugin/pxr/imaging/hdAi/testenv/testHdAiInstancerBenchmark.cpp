@@ -0,0 +1,128 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "testHdAiBenchmark.h"
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdio>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+// Each tree is a 16 by 16 grid, 256 quads.
+constexpr int treeSize = 16;
+
+struct ForestResult {
+    double syncTime = 0.0;
+    double renderTime = 0.0;
+    double usedMemory = 0.0;
+    size_t numNodes = 0;
+};
+
+/// Places \p numTrees trees on a square grid, either as instances of a
+/// single prototype or as copies of the mesh, and renders them.
+ForestResult _RenderForest(int numTrees, bool instanced) {
+    const auto side = static_cast<int>(std::ceil(std::sqrt(numTrees)));
+    const auto getPosition = [&](int i) -> GfVec3f {
+        return GfVec3f(
+            (i % side) * 3.0f - side * 1.5f, (i / side) * 3.0f - side * 1.5f,
+            0.0f);
+    };
+
+    HdAiTestScene scene;
+    scene.renderDelegate.SetRenderSetting(TfToken("AA_samples"), VtValue(1));
+    scene.renderDelegate.SetRenderSetting(
+        TfToken("enable_progressive_render"), VtValue(false));
+    const auto memoryBefore = AiMsgUtilGetUsedMemory();
+
+    std::vector<SdfPath> ids;
+    if (instanced) {
+        const SdfPath instancerId("/forest");
+        auto& instancer = scene.delegate.AddInstancer(instancerId);
+        const SdfPath treeId("/forest/tree");
+        scene.delegate.AddGrid(treeId, treeSize, instancerId);
+        VtVec3fArray translates(numTrees);
+        VtIntArray indices(numTrees);
+        for (auto i = 0; i < numTrees; ++i) {
+            translates[i] = getPosition(i);
+            indices[i] = i;
+        }
+        scene.delegate.SetPrimvar(
+            instancerId, HdInstancerTokens->translate, VtValue(translates),
+            HdInterpolationInstance);
+        instancer.instanceIndices[treeId] = indices;
+        ids.push_back(treeId);
+    } else {
+        for (auto i = 0; i < numTrees; ++i) {
+            const SdfPath treeId(TfStringPrintf("/tree_%d", i));
+            scene.delegate.AddGrid(treeId, treeSize).transform =
+                GfMatrix4d(1.0).SetTranslate(GfVec3d(getPosition(i)));
+            ids.push_back(treeId);
+        }
+    }
+
+    ForestResult result;
+    result.syncTime = hdAiTestTime(1, [&]() {
+        for (const auto& id : ids) { scene.delegate.SyncRprim(id); }
+        scene.Commit();
+    });
+    HdAiTestRenderPass pass(
+        scene, 128, 128,
+        GfMatrix4d(1.0).SetTranslate(GfVec3d(0.0, 0.0, side * 3.0)));
+    const auto timeout =
+        std::chrono::steady_clock::now() + std::chrono::seconds(3600);
+    result.renderTime = hdAiTestTime(1, [&]() {
+        EXPECT_TRUE(hdAiTestRenderUntilConverged({&pass}, timeout));
+    });
+    // Includes the acceleration structures built by the render.
+    result.usedMemory =
+        static_cast<double>(AiMsgUtilGetUsedMemory() - memoryBefore) /
+        (1024.0 * 1024.0);
+    auto* iter = AiUniverseGetNodeIterator(
+        scene.renderDelegate.GetUniverse(), AI_NODE_SHAPE);
+    while (!AiNodeIteratorFinished(iter)) {
+        AiNodeIteratorGetNext(iter);
+        ++result.numNodes;
+    }
+    AiNodeIteratorDestroy(iter);
+    return result;
+}
+
+void _Report(const char* name, int numTrees, const ForestResult& result) {
+    const auto label = TfStringPrintf("%s, %d trees", name, numTrees);
+    hdAiTestReport((label + ", sync").c_str(), result.syncTime);
+    hdAiTestReport((label + ", first render").c_str(), result.renderTime);
+    printf(
+        "[ MEMORY   ] %s: %.1f MiB, %.1f bytes per tree, %zu shapes\n",
+        label.c_str(), result.usedMemory,
+        result.usedMemory * 1024.0 * 1024.0 / numTrees, result.numNodes);
+}
+
+} // namespace
+
+TEST(HdAiInstancerBenchmark, Forest) {
+    // Copies of the mesh are the alternative the host falls back to without
+    // an instancer, they only run at a smaller size.
+    constexpr int numCopies = 10000;
+    _Report("copies", numCopies, _RenderForest(numCopies, false));
+    _Report("instances", numCopies, _RenderForest(numCopies, true));
+    constexpr int numInstances = 1000000;
+    _Report("instances", numInstances, _RenderForest(numInstances, true));
+}
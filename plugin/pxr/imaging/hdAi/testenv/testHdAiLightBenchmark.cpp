@@ -0,0 +1,91 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "testHdAiBenchmark.h"
+
+#include <pxr/imaging/hd/light.h>
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr int numLights = 1000;
+constexpr size_t numFrames = 24;
+
+SdfPath _GetLightPath(int i) {
+    return SdfPath(TfStringPrintf("/light_%d", i));
+}
+
+float _GetIntensity(int light, size_t frame) {
+    return 1.0f + static_cast<float>((light + frame) % 10);
+}
+
+} // namespace
+
+// Animated lights are dirtied on every frame, but usually only a parameter
+// or two changes, so only those are written to the Arnold nodes.
+TEST(HdAiLightBenchmark, AnimatedIntensity) {
+    HdAiTestScene scene;
+    for (auto i = 0; i < numLights; ++i) {
+        const auto id = _GetLightPath(i);
+        auto& light =
+            scene.delegate.AddSprim(HdPrimTypeTokens->sphereLight, id);
+        light.params[HdLightTokens->intensity] = VtValue(_GetIntensity(i, 0));
+        light.params[HdLightTokens->exposure] = VtValue(0.0f);
+        light.params[HdLightTokens->color] = VtValue(GfVec3f(1.0f));
+        light.params[HdLightTokens->radius] = VtValue(0.5f);
+        light.transform =
+            GfMatrix4d(1.0).SetTranslate(GfVec3d(i % 32, i / 32, 5.0));
+    }
+    const auto initial = hdAiTestTime(1, [&]() {
+        for (auto i = 0; i < numLights; ++i) {
+            scene.delegate.SyncSprim(
+                HdPrimTypeTokens->sphereLight, _GetLightPath(i));
+        }
+        scene.Commit();
+    });
+    hdAiTestReport("1k lights, first sync", initial);
+
+    size_t frame = 0;
+    const auto syncFrame = [&](bool animated) {
+        ++frame;
+        for (auto i = 0; i < numLights; ++i) {
+            const auto id = _GetLightPath(i);
+            if (animated) {
+                scene.delegate.GetPrim(id).params[HdLightTokens->intensity] =
+                    VtValue(_GetIntensity(i, frame));
+            }
+            scene.delegate.SyncSprim(
+                HdPrimTypeTokens->sphereLight, id, HdLight::DirtyParams);
+        }
+        scene.Commit();
+    };
+    hdAiTestReport(
+        "1k lights, animated intensity, per frame",
+        hdAiTestTime(numFrames, [&]() { syncFrame(true); }));
+    auto* universe = scene.renderDelegate.GetUniverse();
+    for (auto i = 0; i < numLights; ++i) {
+        auto* node = AiNodeLookUpByName(universe, _GetLightPath(i).GetText());
+        ASSERT_NE(node, nullptr);
+        EXPECT_EQ(AiNodeGetFlt(node, "intensity"), _GetIntensity(i, frame));
+    }
+    hdAiTestReport(
+        "1k lights, dirty without changes, per frame",
+        hdAiTestTime(numFrames, [&]() { syncFrame(false); }));
+}
@@ -0,0 +1,177 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include <pxr/imaging/hd/light.h>
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+const TfToken setA("setA");
+const TfToken setB("setB");
+const TfToken lightLink("lightLink");
+const TfToken shadowLink("shadowLink");
+
+constexpr int numInstances = 3;
+
+using Names = std::set<std::string>;
+
+/// Three lights, the first one illuminates setA, the second one only casts
+/// shadows on setB and the third one is not linked. The shapes are in
+/// overlapping collections, and an instanced prototype is in setA.
+class HdAiLightLinkingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto& delegate = scene.delegate;
+        delegate.AddSprim(HdPrimTypeTokens->sphereLight, lightA)
+            .params[lightLink] = VtValue(setA);
+        delegate.AddSprim(HdPrimTypeTokens->sphereLight, lightB)
+            .params[shadowLink] = VtValue(setB);
+        delegate.AddSprim(HdPrimTypeTokens->sphereLight, lightC);
+
+        delegate.AddQuad(both).categories = {setA, setB};
+        delegate.AddQuad(onlyA).categories = {setA};
+        delegate.AddQuad(onlyB).categories = {setB};
+        delegate.AddQuad(none);
+
+        auto& instancer = delegate.AddInstancer(instancerId);
+        delegate.AddQuad(prototypeId, instancerId).categories = {setA};
+        VtVec3fArray translates(numInstances);
+        VtIntArray indices(numInstances);
+        for (auto i = 0; i < numInstances; ++i) {
+            translates[i] = GfVec3f(3.0f * i, 0.0f, 0.0f);
+            indices[i] = i;
+        }
+        delegate.SetPrimvar(
+            instancerId, HdInstancerTokens->translate, VtValue(translates),
+            HdInterpolationInstance);
+        instancer.instanceIndices[prototypeId] = indices;
+
+        for (const auto& id : {lightA, lightB, lightC}) {
+            delegate.SyncSprim(HdPrimTypeTokens->sphereLight, id);
+        }
+        for (const auto& id : {both, onlyA, onlyB, none, prototypeId}) {
+            delegate.SyncRprim(id);
+        }
+        scene.Commit();
+    }
+
+    AtNode* GetNode(const std::string& name) {
+        return AiNodeLookUpByName(
+            scene.renderDelegate.GetUniverse(), name.c_str());
+    }
+
+    std::string GetInstanceName(int i) {
+        return TfStringPrintf("%s/instance_%d", prototypeId.GetText(), i);
+    }
+
+    /// Returns the names of the lights in \p group, if \p useGroup is set.
+    /// Otherwise the shape sees every light and nothing is returned.
+    bool GetGroup(
+        const std::string& shape, const char* group, const char* useGroup,
+        Names& names) {
+        names.clear();
+        auto* node = GetNode(shape);
+        EXPECT_NE(node, nullptr) << shape;
+        if (node == nullptr || !AiNodeGetBool(node, useGroup)) {
+            return false;
+        }
+        const auto* arr = AiNodeGetArray(node, group);
+        for (uint32_t i = 0; i < AiArrayGetNumElements(arr); ++i) {
+            names.insert(AiNodeGetName(
+                static_cast<const AtNode*>(AiArrayGetPtr(arr, i))));
+        }
+        return true;
+    }
+
+    void ExpectLights(const std::string& shape, const Names* expected) {
+        Names names;
+        const auto used =
+            GetGroup(shape, "light_group", "use_light_group", names);
+        EXPECT_EQ(used, expected != nullptr) << shape;
+        if (used && expected != nullptr) { EXPECT_EQ(names, *expected); }
+    }
+
+    void ExpectShadows(const std::string& shape, const Names* expected) {
+        Names names;
+        const auto used =
+            GetGroup(shape, "shadow_group", "use_shadow_group", names);
+        EXPECT_EQ(used, expected != nullptr) << shape;
+        if (used && expected != nullptr) { EXPECT_EQ(names, *expected); }
+    }
+
+    HdAiTestScene scene;
+    const SdfPath lightA{"/lightA"};
+    const SdfPath lightB{"/lightB"};
+    const SdfPath lightC{"/lightC"};
+    const SdfPath both{"/both"};
+    const SdfPath onlyA{"/onlyA"};
+    const SdfPath onlyB{"/onlyB"};
+    const SdfPath none{"/none"};
+    const SdfPath instancerId{"/instancer"};
+    const SdfPath prototypeId{"/instancer/prototype"};
+    const Names withoutA{"/lightB", "/lightC"};
+    const Names withoutB{"/lightA", "/lightC"};
+};
+
+} // namespace
+
+TEST_F(HdAiLightLinkingTest, OverlappingCollections) {
+    ExpectLights(both.GetString(), nullptr);
+    ExpectShadows(both.GetString(), nullptr);
+    ExpectLights(onlyA.GetString(), nullptr);
+    ExpectShadows(onlyA.GetString(), &withoutB);
+    ExpectLights(onlyB.GetString(), &withoutA);
+    ExpectShadows(onlyB.GetString(), nullptr);
+    ExpectLights(none.GetString(), &withoutA);
+    ExpectShadows(none.GetString(), &withoutB);
+}
+
+// The ginstance nodes are rendered instead of the hidden prototype, so they
+// carry its groups.
+TEST_F(HdAiLightLinkingTest, Instances) {
+    for (auto i = 0; i < numInstances; ++i) {
+        ExpectLights(GetInstanceName(i), nullptr);
+        ExpectShadows(GetInstanceName(i), &withoutB);
+    }
+
+    scene.delegate.GetPrim(prototypeId).categories = {setB};
+    scene.delegate.SyncRprim(prototypeId, HdChangeTracker::DirtyCategories);
+    scene.Commit();
+    for (auto i = 0; i < numInstances; ++i) {
+        ExpectLights(GetInstanceName(i), &withoutA);
+        ExpectShadows(GetInstanceName(i), nullptr);
+    }
+}
+
+// Unlinking a light writes the groups of every shape again.
+TEST_F(HdAiLightLinkingTest, UnlinkLight) {
+    scene.delegate.GetPrim(lightA).params[lightLink] = VtValue(TfToken());
+    scene.delegate.SyncSprim(
+        HdPrimTypeTokens->sphereLight, lightA, HdLight::DirtyParams);
+    scene.Commit();
+    for (const auto& shape : {both, onlyA, onlyB, none}) {
+        ExpectLights(shape.GetString(), nullptr);
+    }
+    ExpectShadows(none.GetString(), &withoutB);
+    ExpectLights(GetInstanceName(0), nullptr);
+}
@@ -0,0 +1,149 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "testHdAiBenchmark.h"
+
+#include <pxr/imaging/hd/material.h>
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr int numNodes = 200;
+constexpr int numQuads = 10000;
+constexpr int numBound = 100;
+constexpr size_t numEdits = 50;
+
+const SdfPath materialId("/material");
+
+SdfPath _GetNodePath(int i) {
+    return materialId.AppendChild(TfToken(TfStringPrintf("node_%d", i)));
+}
+
+/// A chain of multiply nodes feeding the base color of \p terminalType, the
+/// scrubbed parameter is on the first node of the chain.
+HdMaterialNetworkMap _GetNetwork(const char* terminalType, float scrubbed) {
+    HdMaterialNetwork network;
+    const TfToken multiply("ai:multiply");
+    const TfToken input1("input1");
+    const TfToken input2("input2");
+    const TfToken out("out");
+    for (auto i = 0; i < numNodes - 1; ++i) {
+        HdMaterialNode node;
+        node.path = _GetNodePath(i);
+        node.identifier = multiply;
+        node.parameters[input2] =
+            VtValue(GfVec3f(i == 0 ? scrubbed : 1.0f, 1.0f, 1.0f));
+        if (i == 0) {
+            node.parameters[input1] = VtValue(GfVec3f(0.5f, 0.5f, 0.5f));
+        } else {
+            network.relationships.push_back(
+                {_GetNodePath(i - 1), out, node.path, input1});
+        }
+        network.nodes.push_back(node);
+    }
+    HdMaterialNode terminal;
+    terminal.path = _GetNodePath(numNodes - 1);
+    terminal.identifier = TfToken(terminalType);
+    network.relationships.push_back(
+        {_GetNodePath(numNodes - 2), out, terminal.path,
+         TfToken("base_color")});
+    network.nodes.push_back(terminal);
+    HdMaterialNetworkMap map;
+    map.map[TfToken("bxdf")] = network;
+    return map;
+}
+
+/// Returns the number of quads marked dirty since the last call, and cleans
+/// them.
+int _CountDirtyQuads(HdAiTestScene& scene) {
+    auto& tracker = scene.renderIndex->GetChangeTracker();
+    auto numDirty = 0;
+    for (auto i = 0; i < numQuads; ++i) {
+        const SdfPath id(TfStringPrintf("/quad_%d", i));
+        if (tracker.GetRprimDirtyBits(id) &
+            HdChangeTracker::DirtyMaterialId) {
+            ++numDirty;
+        }
+        tracker.MarkRprimClean(id);
+    }
+    return numDirty;
+}
+
+} // namespace
+
+// Lookdev edits a single parameter of a large network while the scene is
+// rendering. Only the nodes depending on the parameter are written, and the
+// shapes are only touched when the surface shader changes, and then only the
+// shapes bound to the material.
+TEST(HdAiMaterialBenchmark, ScrubParameter) {
+    HdAiTestScene scene;
+    auto& material =
+        scene.delegate.AddSprim(HdPrimTypeTokens->material, materialId);
+    material.materialResource =
+        VtValue(_GetNetwork("ai:standard_surface", 0.0f));
+    for (auto i = 0; i < numQuads; ++i) {
+        const SdfPath id(TfStringPrintf("/quad_%d", i));
+        auto& quad = scene.delegate.AddQuad(id);
+        if (i < numBound) { quad.materialId = materialId; }
+    }
+    const auto initial = hdAiTestTime(1, [&]() {
+        scene.delegate.SyncSprim(HdPrimTypeTokens->material, materialId);
+        for (auto i = 0; i < numQuads; ++i) {
+            scene.delegate.SyncRprim(SdfPath(TfStringPrintf("/quad_%d", i)));
+        }
+        scene.Commit();
+    });
+    hdAiTestReport("200 node network, 10k quads, first sync", initial);
+    // Clears the bits of the inserted quads, which are synced by hand.
+    _CountDirtyQuads(scene);
+
+    size_t edit = 0;
+    const auto scrub = hdAiTestTime(numEdits, [&]() {
+        ++edit;
+        material.materialResource = VtValue(_GetNetwork(
+            "ai:standard_surface", static_cast<float>(edit) / numEdits));
+        scene.delegate.SyncSprim(
+            HdPrimTypeTokens->material, materialId, HdMaterial::DirtyResource);
+        scene.Commit();
+    });
+    hdAiTestReport("200 node network, scrub one parameter", scrub);
+    // The terminal stays the same node, so no shape is dirtied.
+    EXPECT_EQ(_CountDirtyQuads(scene), 0);
+
+    const char* terminals[] = {"ai:lambert", "ai:standard_surface"};
+    edit = 0;
+    const auto swap = hdAiTestTime(numEdits, [&]() {
+        material.materialResource =
+            VtValue(_GetNetwork(terminals[edit++ % 2], 0.5f));
+        scene.delegate.SyncSprim(
+            HdPrimTypeTokens->material, materialId, HdMaterial::DirtyResource);
+        scene.Commit();
+    });
+    hdAiTestReport("200 node network, swap the surface shader", swap);
+    const auto numDirty = _CountDirtyQuads(scene);
+    printf(
+        "[ DIRTY    ] %d of %d quads dirtied by a new surface shader\n",
+        numDirty, numQuads);
+    // Only the bound quads, or none if the new terminal got the address of
+    // the destroyed one.
+    EXPECT_LE(numDirty, numBound);
+}
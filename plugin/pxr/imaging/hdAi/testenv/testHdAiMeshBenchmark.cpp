@@ -0,0 +1,220 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "pxr/imaging/hdAi/config.h"
+#include "pxr/imaging/hdAi/utils.h"
+
+#include "testHdAiBenchmark.h"
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <random>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+// Grid sizes of 10k, 100k, 1M and 10M quads.
+constexpr int gridSizes[] = {100, 316, 1000, 3162};
+
+/// Converts \p indices one element at a time, like the mesh did before the
+/// bulk conversion.
+AtArray* _ConvertIndicesPerElement(const VtIntArray& indices) {
+    const auto numIndices = static_cast<uint32_t>(indices.size());
+    auto* arr = AiArrayAllocate(numIndices, 1, AI_TYPE_UINT);
+    for (auto i = decltype(numIndices){0}; i < numIndices; ++i) {
+        AiArraySetUInt(arr, i, static_cast<uint32_t>(indices[i]));
+    }
+    return arr;
+}
+
+VtVec3fArray _GenerateVectors(size_t count, float scale) {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-scale, scale);
+    VtVec3fArray ret(count);
+    for (auto& v : ret) { v = GfVec3f(dist(gen), dist(gen), dist(gen)); }
+    return ret;
+}
+
+} // namespace
+
+TEST(HdAiMeshBenchmark, TopologyConversion) {
+    HdAiTestScene scene;
+    for (const auto size : gridSizes) {
+        const auto numFaces = size * size;
+        VtIntArray indices(numFaces * 4);
+        for (auto i = 0; i < numFaces * 4; ++i) { indices[i] = i; }
+        const auto bulk = hdAiTestTime(5, [&]() {
+            AiArrayDestroy(HdAiConvertIndices(indices));
+        });
+        const auto perElement = hdAiTestTime(5, [&]() {
+            AiArrayDestroy(_ConvertIndicesPerElement(indices));
+        });
+        hdAiTestReport(
+            TfStringPrintf("vidxs of %d quads, bulk", numFaces).c_str(),
+            bulk);
+        hdAiTestReport(
+            TfStringPrintf("vidxs of %d quads, per element", numFaces)
+                .c_str(),
+            perElement);
+        auto* converted = HdAiConvertIndices(indices);
+        ASSERT_EQ(AiArrayGetNumElements(converted), indices.size());
+        const auto* data =
+            static_cast<const uint32_t*>(AiArrayMap(converted));
+        for (size_t i = 0; i < indices.size(); ++i) {
+            ASSERT_EQ(data[i], static_cast<uint32_t>(indices[i]));
+        }
+        AiArrayUnmap(converted);
+        AiArrayDestroy(converted);
+    }
+}
+
+TEST(HdAiMeshBenchmark, Translation) {
+    for (const auto size : gridSizes) {
+        HdAiTestScene scene;
+        const SdfPath id("/grid");
+        scene.delegate.AddGrid(id, size);
+        const auto ms = hdAiTestTime(1, [&]() {
+            scene.delegate.SyncRprim(id);
+            scene.Commit();
+        });
+        const auto numFaces = size * size;
+        hdAiTestReport(
+            TfStringPrintf("first sync of %d quads", numFaces).c_str(), ms);
+        printf(
+            "[ RATE     ] %d quads: %.1f M faces per second\n", numFaces,
+            numFaces / (ms * 1000.0));
+    }
+}
+
+TEST(HdAiMeshBenchmark, VelocityMotionKeys) {
+    constexpr size_t numPoints = 5000000;
+    const auto& config = HdAiConfig::GetInstance();
+    ASSERT_TRUE(config.velocity_motion_blur);
+    HdAiTestScene scene;
+    auto& delegate = scene.delegate;
+    const auto points = _GenerateVectors(numPoints, 100.0f);
+    const auto velocities = _GenerateVectors(numPoints, 10.0f);
+    const auto accelerations = _GenerateVectors(numPoints, 1.0f);
+
+    const SdfPath twoSamples("/twoSamples");
+    auto& primvar = delegate.GetPrim(twoSamples).primvars[HdTokens->points];
+    primvar.value = VtValue(points);
+    primvar.interpolation = HdInterpolationVertex;
+    // The second sample is where the velocities would move the points.
+    VtVec3fArray endPoints(numPoints);
+    for (size_t i = 0; i < numPoints; ++i) {
+        endPoints[i] = points[i] + velocities[i] * 0.02f;
+    }
+    primvar.times = {config.shutter_start, config.shutter_end};
+    primvar.samples = {VtValue(points), VtValue(endPoints)};
+
+    const SdfPath velocity("/velocity");
+    delegate.SetPrimvar(
+        velocity, HdTokens->points, VtValue(points), HdInterpolationVertex);
+    delegate.SetPrimvar(
+        velocity, TfToken("velocities"), VtValue(velocities),
+        HdInterpolationVertex);
+
+    const SdfPath acceleration("/acceleration");
+    delegate.SetPrimvar(
+        acceleration, HdTokens->points, VtValue(points),
+        HdInterpolationVertex);
+    delegate.SetPrimvar(
+        acceleration, TfToken("velocities"), VtValue(velocities),
+        HdInterpolationVertex);
+    delegate.SetPrimvar(
+        acceleration, TfToken("accelerations"), VtValue(accelerations),
+        HdInterpolationVertex);
+
+    const auto numKeys = static_cast<uint8_t>(config.deformation_motion_keys);
+    HdAiMotionSamples samples;
+    const auto timeKeys = [&](const SdfPath& id) -> double {
+        return hdAiTestTime(5, [&]() {
+            auto* arr = HdAiSampleDeformationKeys(
+                &delegate, id, HdTokens->points, samples);
+            ASSERT_NE(arr, nullptr);
+            EXPECT_EQ(AiArrayGetNumElements(arr), numPoints);
+            EXPECT_EQ(AiArrayGetNumKeys(arr), numKeys);
+            AiArrayDestroy(arr);
+        });
+    };
+    // The arrays read from the scene delegate, on top of the topology.
+    const auto inputMiB = [](size_t numArrays) -> double {
+        return static_cast<double>(numArrays * numPoints * sizeof(GfVec3f)) /
+               (1024.0 * 1024.0);
+    };
+
+    hdAiTestReport("5M points, two samples", timeKeys(twoSamples));
+    printf("[ MEMORY   ] two samples: %.1f MiB read\n", inputMiB(2));
+    hdAiTestReport("5M points, velocities", timeKeys(velocity));
+    printf("[ MEMORY   ] velocities: %.1f MiB read\n", inputMiB(2));
+    hdAiTestReport(
+        "5M points, velocities and accelerations", timeKeys(acceleration));
+    printf(
+        "[ MEMORY   ] velocities and accelerations: %.1f MiB read\n",
+        inputMiB(3));
+}
+
+TEST(HdAiMeshBenchmark, FaceVaryingWeld) {
+    HdAiTestScene scene;
+    for (const auto size : gridSizes) {
+        // Face-varying uvs of a grid, every vertex is shared by four faces.
+        const auto numFaces = size * size;
+        VtVec2fArray uvs(numFaces * 4);
+        for (auto face = 0; face < numFaces; ++face) {
+            const auto u = static_cast<float>(face % size);
+            const auto v = static_cast<float>(face / size);
+            uvs[face * 4] = GfVec2f(u, v);
+            uvs[face * 4 + 1] = GfVec2f(u + 1.0f, v);
+            uvs[face * 4 + 2] = GfVec2f(u + 1.0f, v + 1.0f);
+            uvs[face * 4 + 3] = GfVec2f(u, v + 1.0f);
+        }
+        const VtValue value(uvs);
+        size_t weldedBytes = 0;
+        const auto weld = hdAiTestTime(3, [&]() {
+            TfToken type;
+            AtArray* values = nullptr;
+            AtArray* indices = nullptr;
+            ASSERT_TRUE(
+                HdAiWeldFaceVarying(value, false, type, values, indices));
+            weldedBytes =
+                AiArrayGetNumElements(values) * sizeof(GfVec2f) +
+                AiArrayGetNumElements(indices) * sizeof(uint32_t);
+            AiArrayDestroy(values);
+            AiArrayDestroy(indices);
+        });
+        const auto flat = hdAiTestTime(3, [&]() {
+            AiArrayDestroy(AiArrayConvert(
+                static_cast<uint32_t>(uvs.size()), 1, AI_TYPE_VECTOR2,
+                uvs.cdata()));
+            AiArrayDestroy(HdAiGenerateIdentityIndices(
+                static_cast<uint32_t>(uvs.size())));
+        });
+        const auto flatBytes =
+            uvs.size() * (sizeof(GfVec2f) + sizeof(uint32_t));
+        hdAiTestReport(
+            TfStringPrintf("uvs of %d quads, welded", numFaces).c_str(), weld);
+        hdAiTestReport(
+            TfStringPrintf("uvs of %d quads, flat", numFaces).c_str(), flat);
+        printf(
+            "[ MEMORY   ] uvs of %d quads: %.1f MiB welded, %.1f MiB flat\n",
+            numFaces, weldedBytes / (1024.0 * 1024.0),
+            flatBytes / (1024.0 * 1024.0));
+    }
+}
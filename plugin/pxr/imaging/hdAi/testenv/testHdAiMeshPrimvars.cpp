@@ -0,0 +1,145 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr int gridSize = 4;
+constexpr int numPrimvars = 20;
+
+TfToken _PrimvarName(int i) {
+    return TfToken(TfStringPrintf("primvar%d", i));
+}
+
+VtFloatArray _PrimvarValue(float value) {
+    return VtFloatArray((gridSize + 1) * (gridSize + 1), value);
+}
+
+class HdAiMeshPrimvarsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        scene.delegate.AddGrid(id, gridSize);
+        for (auto i = 0; i < numPrimvars; ++i) {
+            scene.delegate.SetPrimvar(
+                id, _PrimvarName(i), VtValue(_PrimvarValue(i)),
+                HdInterpolationVertex);
+        }
+    }
+
+    void Sync(HdDirtyBits dirtyBits) {
+        scene.delegate.SyncRprim(id, dirtyBits);
+        scene.Commit();
+    }
+
+    AtNode* GetMesh() {
+        return AiNodeLookUpByName(
+            scene.renderDelegate.GetUniverse(), id.GetText());
+    }
+
+    /// Returns the array of each primvar, the arrays that are not written
+    /// again by a sync keep their address.
+    std::vector<const AtArray*> GetArrays() {
+        std::vector<const AtArray*> ret;
+        auto* mesh = GetMesh();
+        for (auto i = 0; i < numPrimvars; ++i) {
+            ret.push_back(AiNodeGetArray(mesh, _PrimvarName(i).GetText()));
+        }
+        return ret;
+    }
+
+    HdAiTestScene scene;
+    const SdfPath id{"/grid"};
+};
+
+} // namespace
+
+// Hydra only flags that some primvar changed, only the animated one must be
+// converted and written again.
+TEST_F(HdAiMeshPrimvarsTest, OnlyChangedPrimvarIsWritten) {
+    Sync(HdChangeTracker::AllDirty);
+    const auto before = GetArrays();
+    for (const auto* arr : before) { ASSERT_NE(arr, nullptr); }
+
+    constexpr int animated = 7;
+    for (auto frame = 1; frame <= 3; ++frame) {
+        scene.delegate.SetPrimvar(
+            id, _PrimvarName(animated),
+            VtValue(_PrimvarValue(100.0f * frame)), HdInterpolationVertex);
+        Sync(HdChangeTracker::DirtyPrimvar);
+        const auto after = GetArrays();
+        auto written = 0;
+        for (auto i = 0; i < numPrimvars; ++i) {
+            if (after[i] != before[i]) { ++written; }
+        }
+        EXPECT_EQ(written, 1);
+        EXPECT_NE(after[animated], before[animated]);
+        EXPECT_EQ(AiArrayGetFlt(after[animated], 0), 100.0f * frame);
+    }
+}
+
+// The color primvar is always declared as RGBA, even when synced again.
+TEST_F(HdAiMeshPrimvarsTest, ColorStaysRGBA) {
+    const auto name = HdPrimvarRoleTokens->color;
+    for (const auto alpha : {0.5f, 0.25f}) {
+        scene.delegate.SetPrimvar(
+            id, name, VtValue(GfVec4f(1.0f, 0.5f, 0.25f, alpha)),
+            HdInterpolationConstant, HdPrimvarRoleTokens->color);
+        Sync(HdChangeTracker::AllDirty);
+        auto* mesh = GetMesh();
+        const auto* param = AiNodeLookUpUserParameter(mesh, name.GetText());
+        ASSERT_NE(param, nullptr);
+        EXPECT_EQ(AiUserParamGetType(param), AI_TYPE_RGBA);
+        EXPECT_EQ(AiUserParamGetCategory(param), AI_USERDEF_CONSTANT);
+        const auto color = AiNodeGetRGBA(mesh, name.GetText());
+        EXPECT_EQ(color.r, 1.0f);
+        EXPECT_EQ(color.g, 0.5f);
+        EXPECT_EQ(color.b, 0.25f);
+        EXPECT_EQ(color.a, alpha);
+    }
+}
+
+// Removing uvs and normals resets the native arrays of the polymesh.
+TEST_F(HdAiMeshPrimvarsTest, RemovedUVsAndNormals) {
+    const auto numVerts =
+        static_cast<uint32_t>((gridSize + 1) * (gridSize + 1));
+    scene.delegate.SetPrimvar(
+        id, TfToken("st"), VtValue(VtVec2fArray(numVerts, GfVec2f(0.5f))),
+        HdInterpolationVertex);
+    scene.delegate.SetPrimvar(
+        id, HdTokens->normals,
+        VtValue(VtVec3fArray(numVerts, GfVec3f(0.0f, 0.0f, 1.0f))),
+        HdInterpolationVertex, HdPrimvarRoleTokens->normal);
+    Sync(HdChangeTracker::AllDirty);
+    auto* mesh = GetMesh();
+    EXPECT_EQ(
+        AiArrayGetNumElements(AiNodeGetArray(mesh, "uvlist")), numVerts);
+    EXPECT_EQ(AiArrayGetNumElements(AiNodeGetArray(mesh, "nlist")), numVerts);
+    EXPECT_GT(AiArrayGetNumElements(AiNodeGetArray(mesh, "uvidxs")), 0u);
+    EXPECT_GT(AiArrayGetNumElements(AiNodeGetArray(mesh, "nidxs")), 0u);
+
+    auto& primvars = scene.delegate.GetPrim(id).primvars;
+    primvars.erase(TfToken("st"));
+    primvars.erase(HdTokens->normals);
+    Sync(HdChangeTracker::DirtyPrimvar);
+    EXPECT_EQ(AiArrayGetNumElements(AiNodeGetArray(mesh, "uvlist")), 0u);
+    EXPECT_EQ(AiArrayGetNumElements(AiNodeGetArray(mesh, "uvidxs")), 0u);
+    EXPECT_EQ(AiArrayGetNumElements(AiNodeGetArray(mesh, "nlist")), 0u);
+    EXPECT_EQ(AiArrayGetNumElements(AiNodeGetArray(mesh, "nidxs")), 0u);
+}
@@ -0,0 +1,89 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "testHdAiBenchmark.h"
+
+#include <pxr/base/work/threadLimits.h>
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr size_t numPoints = 50000000;
+
+/// Syncs a points prim with positions, widths, velocities and two per point
+/// primvars, and reports the time and the memory allocated by Arnold.
+void _SyncPoints(const char* name) {
+    HdAiTestScene scene;
+    const SdfPath id("/points");
+    scene.delegate.AddRprim(HdPrimTypeTokens->points, id);
+    VtVec3fArray points(numPoints);
+    VtVec3fArray velocities(numPoints);
+    VtVec3fArray colors(numPoints);
+    VtFloatArray widths(numPoints);
+    VtFloatArray ids(numPoints);
+    for (size_t i = 0; i < numPoints; ++i) {
+        const auto f = static_cast<float>(i);
+        points[i] = GfVec3f(f, -f, 0.5f * f);
+        velocities[i] = GfVec3f(1.0f, 0.0f, -1.0f);
+        colors[i] = GfVec3f(0.5f, 0.25f, 0.125f);
+        widths[i] = 0.1f;
+        ids[i] = f;
+    }
+    scene.delegate.SetPrimvar(
+        id, HdTokens->points, VtValue(points), HdInterpolationVertex,
+        HdPrimvarRoleTokens->point);
+    scene.delegate.SetPrimvar(
+        id, HdTokens->widths, VtValue(widths), HdInterpolationVertex);
+    scene.delegate.SetPrimvar(
+        id, TfToken("velocities"), VtValue(velocities),
+        HdInterpolationVertex, HdPrimvarRoleTokens->vector);
+    scene.delegate.SetPrimvar(
+        id, HdTokens->displayColor, VtValue(colors), HdInterpolationVertex,
+        HdPrimvarRoleTokens->color);
+    scene.delegate.SetPrimvar(
+        id, TfToken("id"), VtValue(ids), HdInterpolationVertex);
+
+    const auto memoryBefore = AiMsgUtilGetUsedMemory();
+    const auto ms = hdAiTestTime(1, [&]() {
+        scene.delegate.SyncRprim(id);
+        scene.Commit();
+    });
+    const auto usedMemory =
+        static_cast<double>(AiMsgUtilGetUsedMemory() - memoryBefore) /
+        (1024.0 * 1024.0);
+    hdAiTestReport(
+        TfStringPrintf("50M points, %s, sync and commit", name).c_str(), ms);
+    printf(
+        "[ MEMORY   ] 50M points, %s: %.1f MiB, %.1f bytes per point\n", name,
+        usedMemory, usedMemory * 1024.0 * 1024.0 / numPoints);
+}
+
+} // namespace
+
+// The velocity keys, the radius and the per point primvars are converted in
+// parallel chunks, the serial run shows what that saves.
+TEST(HdAiPointsBenchmark, FiftyMillionPoints) {
+    WorkSetConcurrencyLimit(1);
+    _SyncPoints("serial");
+    WorkSetMaximumConcurrencyLimit();
+    _SyncPoints("parallel");
+}
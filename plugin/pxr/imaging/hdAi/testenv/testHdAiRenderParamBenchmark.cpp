@@ -0,0 +1,82 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "testHdAiBenchmark.h"
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr int gridSize = 100;
+constexpr size_t numEdits = 20;
+
+SdfPath _GetQuadPath(int i) {
+    return SdfPath(TfStringPrintf("/quad_%d", i));
+}
+
+GfMatrix4d _GetQuadTransform(int i, double offset) {
+    return GfMatrix4d(1.0).SetTranslate(GfVec3d(
+        (i % gridSize) * 2.5 - gridSize * 1.25 + offset,
+        (i / gridSize) * 2.5 - gridSize * 1.25, 0.0));
+}
+
+/// Drags the first quad of a 10k quad scene, and returns the average time
+/// from the edit to the converged render.
+double _DragTransform(bool endRender) {
+    HdAiTestScene scene;
+    scene.renderDelegate.SetRenderSetting(TfToken("AA_samples"), VtValue(1));
+    scene.renderDelegate.SetRenderSetting(
+        TfToken("enable_progressive_render"), VtValue(false));
+    for (auto i = 0; i < gridSize * gridSize; ++i) {
+        const auto path = _GetQuadPath(i);
+        scene.delegate.AddQuad(path).transform = _GetQuadTransform(i, 0.0);
+        scene.delegate.SyncRprim(path);
+    }
+    scene.Commit();
+    HdAiTestRenderPass pass(
+        scene, 128, 128,
+        GfMatrix4d(1.0).SetTranslate(GfVec3d(0.0, 0.0, 250.0)));
+    const auto timeout =
+        std::chrono::steady_clock::now() + std::chrono::seconds(600);
+    EXPECT_TRUE(hdAiTestRenderUntilConverged({&pass}, timeout));
+
+    const auto dragged = _GetQuadPath(0);
+    size_t edit = 0;
+    return hdAiTestTime(numEdits, [&]() {
+        ++edit;
+        // What every Sync did before edits interrupted the render.
+        if (endRender) { scene.GetRenderParam().End(); }
+        scene.delegate.GetPrim(dragged).transform =
+            _GetQuadTransform(0, static_cast<double>(edit) * 0.1);
+        scene.delegate.SyncRprim(dragged, HdChangeTracker::DirtyTransform);
+        scene.Commit();
+        EXPECT_TRUE(hdAiTestRenderUntilConverged({&pass}, timeout));
+    });
+}
+
+} // namespace
+
+TEST(HdAiRenderParamBenchmark, DragTransform) {
+    hdAiTestReport(
+        "drag one transform in 10k prims, end and begin",
+        _DragTransform(true));
+    hdAiTestReport(
+        "drag one transform in 10k prims, interrupt and restart",
+        _DragTransform(false));
+}
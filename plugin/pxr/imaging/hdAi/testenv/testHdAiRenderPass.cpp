@@ -0,0 +1,94 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include <pxr/base/gf/rotation.h>
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+/// Returns the number of pixels still holding the clear value, and the number
+/// of covered pixels.
+void _CountPixels(
+    HdAiTestRenderPass& pass, size_t& unwritten, size_t& covered) {
+    unwritten = 0;
+    covered = 0;
+    for (const auto& pixel : pass.GetPixels()) {
+        if (pixel == HdAiTestRenderPass::GetClearValue()) {
+            ++unwritten;
+        } else if (pixel[3] > 0.0f) {
+            ++covered;
+        }
+    }
+}
+
+GfMatrix4d _LookingAtQuad(double distance) {
+    return GfMatrix4d(1.0).SetTranslate(GfVec3d(0.0, 0.0, distance));
+}
+
+GfMatrix4d _LookingAway() {
+    GfMatrix4d xform(1.0);
+    xform.SetRotate(GfRotation(GfVec3d(0.0, 1.0, 0.0), 180.0));
+    xform.SetTranslateOnly(GfVec3d(0.0, 0.0, 5.0));
+    return xform;
+}
+
+} // namespace
+
+// Several render passes share one delegate, each must only receive the
+// buckets rendered with its own camera and resolution.
+TEST(HdAiRenderPass, MultiplePasses) {
+    HdAiTestScene scene;
+    scene.renderDelegate.SetRenderSetting(TfToken("AA_samples"), VtValue(1));
+    const SdfPath quadPath("/quad");
+    scene.delegate.AddQuad(quadPath);
+    scene.delegate.SyncRprim(quadPath);
+    scene.Commit();
+
+    HdAiTestRenderPass facing(scene, 64, 48, _LookingAtQuad(5.0));
+    HdAiTestRenderPass away(scene, 40, 32, _LookingAway());
+    HdAiTestRenderPass small(scene, 16, 16, _LookingAtQuad(5.0));
+    const std::vector<HdAiTestRenderPass*> passes = {&facing, &away, &small};
+
+    const auto timeout =
+        std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    ASSERT_TRUE(hdAiTestRenderUntilConverged(passes, timeout));
+
+    size_t unwritten = 0;
+    size_t covered = 0;
+    _CountPixels(facing, unwritten, covered);
+    EXPECT_EQ(unwritten, 0u);
+    EXPECT_GT(covered, 0u);
+    _CountPixels(away, unwritten, covered);
+    EXPECT_EQ(unwritten, 0u);
+    EXPECT_EQ(covered, 0u);
+    _CountPixels(small, unwritten, covered);
+    EXPECT_EQ(unwritten, 0u);
+    EXPECT_GT(covered, 0u);
+
+    // Moving the camera of one pass renders it again, without touching the
+    // images of the other passes.
+    const auto facingPixels = facing.GetPixels();
+    away.SetCamera(_LookingAtQuad(4.0));
+    ASSERT_TRUE(hdAiTestRenderUntilConverged(passes, timeout));
+    _CountPixels(away, unwritten, covered);
+    EXPECT_EQ(unwritten, 0u);
+    EXPECT_GT(covered, 0u);
+    EXPECT_EQ(facing.GetPixels(), facingPixels);
+}
@@ -0,0 +1,194 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "pxr/imaging/hdAi/config.h"
+#include "pxr/imaging/hdAi/utils.h"
+
+#include <ai.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr size_t numPoints = 3;
+
+/// Points moving linearly over time, so the keys interpolated between any two
+/// samples are exact.
+VtVec3fArray _GetLinearPoints(float time) {
+    VtVec3fArray points(numPoints);
+    for (size_t i = 0; i < numPoints; ++i) {
+        points[i] = GfVec3f(
+            static_cast<float>(i) + time, 2.0f * time,
+            -static_cast<float>(i) * time);
+    }
+    return points;
+}
+
+float _GetKeyTime(size_t key, size_t numKeys) {
+    const auto& config = HdAiConfig::GetInstance();
+    if (numKeys < 2) { return 0.0f; }
+    return config.shutter_start + (config.shutter_end - config.shutter_start) *
+                                      static_cast<float>(key) /
+                                      static_cast<float>(numKeys - 1);
+}
+
+class HdAiSampleDeformationKeysTest : public testing::Test {
+protected:
+    HdAiSampleDeformationKeysTest() : _id("/mesh") {
+        _scene.delegate.AddQuad(_id);
+    }
+
+    void _SetSamples(
+        const std::vector<float>& times,
+        const std::vector<VtValue>& samples) {
+        auto& primvar =
+            _scene.delegate.GetPrim(_id).primvars[HdTokens->points];
+        primvar.times = times;
+        primvar.samples = samples;
+        primvar.value = samples.front();
+    }
+
+    void _SetLinearSamples(const std::vector<float>& times) {
+        std::vector<VtValue> samples;
+        for (const auto time : times) {
+            samples.emplace_back(_GetLinearPoints(time));
+        }
+        _SetSamples(times, samples);
+    }
+
+    /// Samples the keys and returns them in key order, or an empty vector if
+    /// there are none.
+    std::vector<VtVec3fArray> _SampleKeys() {
+        HdAiMotionSamples samples;
+        auto* arr = HdAiSampleDeformationKeys(
+            &_scene.delegate, _id, HdTokens->points, samples);
+        std::vector<VtVec3fArray> keys;
+        if (arr == nullptr) { return keys; }
+        EXPECT_EQ(AiArrayGetNumElements(arr), numPoints);
+        const auto numKeys = AiArrayGetNumKeys(arr);
+        const auto* data = static_cast<const GfVec3f*>(AiArrayMap(arr));
+        for (uint8_t key = 0; key < numKeys; ++key) {
+            VtVec3fArray points(numPoints);
+            std::copy(
+                data + key * numPoints, data + (key + 1) * numPoints,
+                points.begin());
+            keys.push_back(points);
+        }
+        AiArrayUnmap(arr);
+        AiArrayDestroy(arr);
+        return keys;
+    }
+
+    /// Checks that every key matches the linear points at its time, clamped
+    /// to the sampled range.
+    void _ExpectLinearKeys(float firstTime, float lastTime) {
+        const auto keys = _SampleKeys();
+        const auto numKeys = static_cast<size_t>(
+            HdAiConfig::GetInstance().deformation_motion_keys);
+        ASSERT_EQ(keys.size(), numKeys);
+        for (size_t key = 0; key < numKeys; ++key) {
+            const auto time = std::min(
+                lastTime, std::max(firstTime, _GetKeyTime(key, numKeys)));
+            const auto expected = _GetLinearPoints(time);
+            for (size_t i = 0; i < numPoints; ++i) {
+                EXPECT_NEAR(keys[key][i][0], expected[i][0], 1e-5f);
+                EXPECT_NEAR(keys[key][i][1], expected[i][1], 1e-5f);
+                EXPECT_NEAR(keys[key][i][2], expected[i][2], 1e-5f);
+            }
+        }
+    }
+
+    HdAiTestScene _scene;
+    SdfPath _id;
+};
+
+} // namespace
+
+// Fewer samples than keys, unevenly spaced over the shutter.
+TEST_F(HdAiSampleDeformationKeysTest, SparseUnevenSamples) {
+    const auto& config = HdAiConfig::GetInstance();
+    _SetLinearSamples({config.shutter_start, 0.1f, config.shutter_end});
+    _ExpectLinearKeys(config.shutter_start, config.shutter_end);
+}
+
+// More samples than twice the keys, so the delegate is asked again.
+TEST_F(HdAiSampleDeformationKeysTest, DenseUnevenSamples) {
+    const auto& config = HdAiConfig::GetInstance();
+    std::vector<float> times;
+    const auto numKeys =
+        static_cast<size_t>(config.deformation_motion_keys);
+    const auto numSamples = numKeys * 2 + 3;
+    for (size_t i = 0; i < numSamples; ++i) {
+        // Squaring the fraction clusters the samples at the start.
+        const auto t = static_cast<float>(i) / (numSamples - 1);
+        times.push_back(
+            config.shutter_start +
+            (config.shutter_end - config.shutter_start) * t * t);
+    }
+    _SetLinearSamples(times);
+    _ExpectLinearKeys(config.shutter_start, config.shutter_end);
+}
+
+// Keys outside of the sampled range hold the closest sample.
+TEST_F(HdAiSampleDeformationKeysTest, SamplesInsideShutter) {
+    const auto& config = HdAiConfig::GetInstance();
+    const auto firstTime = config.shutter_start * 0.4f;
+    const auto lastTime = config.shutter_end * 0.2f;
+    _SetLinearSamples({firstTime, lastTime});
+    _ExpectLinearKeys(firstTime, lastTime);
+}
+
+// A sample landing on a key is copied as is, even when the motion is not
+// linear.
+TEST_F(HdAiSampleDeformationKeysTest, SampleOnKey) {
+    const auto& config = HdAiConfig::GetInstance();
+    const auto numKeys =
+        static_cast<size_t>(config.deformation_motion_keys);
+    if (numKeys < 3) { return; }
+    const auto keyTime = _GetKeyTime(1, numKeys);
+    const VtVec3fArray bump(numPoints, GfVec3f(10.0f));
+    _SetSamples(
+        {config.shutter_start, keyTime, config.shutter_end},
+        {VtValue(_GetLinearPoints(config.shutter_start)), VtValue(bump),
+         VtValue(_GetLinearPoints(config.shutter_end))});
+    const auto keys = _SampleKeys();
+    ASSERT_EQ(keys.size(), numKeys);
+    EXPECT_EQ(keys[0], _GetLinearPoints(config.shutter_start));
+    EXPECT_EQ(keys[1], bump);
+    EXPECT_EQ(keys[numKeys - 1], _GetLinearPoints(config.shutter_end));
+}
+
+// Samples with a different number of points are skipped.
+TEST_F(HdAiSampleDeformationKeysTest, MismatchedSample) {
+    const auto& config = HdAiConfig::GetInstance();
+    _SetSamples(
+        {config.shutter_start, 0.0f, config.shutter_end},
+        {VtValue(_GetLinearPoints(config.shutter_start)),
+         VtValue(VtVec3fArray(numPoints + 1, GfVec3f(10.0f))),
+         VtValue(_GetLinearPoints(config.shutter_end))});
+    _ExpectLinearKeys(config.shutter_start, config.shutter_end);
+}
+
+// A single sample can't describe motion, so there is a single key.
+TEST_F(HdAiSampleDeformationKeysTest, SingleSample) {
+    _SetLinearSamples({0.0f});
+    const auto keys = _SampleKeys();
+    ASSERT_EQ(keys.size(), 1u);
+    EXPECT_EQ(keys[0], _GetLinearPoints(0.0f));
+}
@@ -0,0 +1,111 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "testHdAiDelegate.h"
+
+#include "testHdAiBenchmark.h"
+
+#include <pxr/base/work/threadLimits.h>
+#include <pxr/imaging/hd/engine.h>
+#include <pxr/imaging/hd/renderPass.h>
+#include <pxr/imaging/hd/task.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+namespace {
+
+constexpr int numMeshes = 10000;
+constexpr int gridSize = 32;
+
+const SdfPath taskId("/syncTask");
+
+/// Only syncs the rprims of its render pass, so the engine runs the parallel
+/// rprim sync of the render index and commits the resources, without
+/// rendering.
+class _SyncTask final : public HdTask {
+public:
+    _SyncTask(HdSceneDelegate* delegate, const SdfPath& id) : HdTask(id) {
+        TF_UNUSED(delegate);
+    }
+
+    void SetRenderPass(const HdRenderPassSharedPtr& pass) { _pass = pass; }
+
+    void Sync(
+        HdSceneDelegate* delegate, HdTaskContext* ctx,
+        HdDirtyBits* dirtyBits) override {
+        TF_UNUSED(delegate);
+        TF_UNUSED(ctx);
+        _pass->Sync();
+        *dirtyBits = HdChangeTracker::Clean;
+    }
+
+    void Prepare(HdTaskContext* ctx, HdRenderIndex* renderIndex) override {
+        TF_UNUSED(ctx);
+        TF_UNUSED(renderIndex);
+    }
+
+    void Execute(HdTaskContext* ctx) override { TF_UNUSED(ctx); }
+
+private:
+    HdRenderPassSharedPtr _pass;
+};
+
+/// Returns the time of the first frame translation of the meshes, with the
+/// work dispatcher limited to \p numThreads.
+double _TranslateFirstFrame(unsigned numThreads) {
+    WorkSetConcurrencyLimit(numThreads);
+    HdAiTestScene scene;
+    for (auto i = 0; i < numMeshes; ++i) {
+        const SdfPath id(TfStringPrintf("/mesh_%d", i));
+        scene.delegate.AddGrid(id, gridSize).transform =
+            GfMatrix4d(1.0).SetTranslate(
+                GfVec3d((i % 100) * 2.5, (i / 100) * 2.5, 0.0));
+    }
+    auto& renderIndex = *scene.renderIndex;
+    renderIndex.InsertTask<_SyncTask>(&scene.delegate, taskId);
+    auto task = renderIndex.GetTask(taskId);
+    std::static_pointer_cast<_SyncTask>(task)->SetRenderPass(
+        scene.renderDelegate.CreateRenderPass(
+            &renderIndex,
+            HdRprimCollection(
+                HdTokens->geometry, HdReprSelector(HdReprTokens->hull))));
+    HdTaskSharedPtrVector tasks = {task};
+    HdEngine engine;
+    return hdAiTestTime(1, [&]() { engine.Execute(&renderIndex, &tasks); });
+}
+
+} // namespace
+
+// The rprims are synced in parallel by the render index, and their staged
+// writes are committed serially. Runs with one thread and then doubles the
+// thread count up to the concurrency limit, so the scaling can be measured
+// on 16 and 64 core machines. PXR_WORK_THREAD_LIMIT caps the largest count.
+TEST(HdAiSyncBenchmark, FirstFrame) {
+    const auto maxThreads = WorkGetConcurrencyLimit();
+    std::vector<unsigned> threadCounts;
+    for (unsigned n = 1; n < maxThreads; n *= 2) { threadCounts.push_back(n); }
+    threadCounts.push_back(maxThreads);
+    for (const auto numThreads : threadCounts) {
+        hdAiTestReport(
+            TfStringPrintf(
+                "first frame of 10k meshes, 10M quads, %u threads",
+                numThreads)
+                .c_str(),
+            _TranslateFirstFrame(numThreads));
+    }
+    WorkSetConcurrencyLimit(maxThreads);
+}
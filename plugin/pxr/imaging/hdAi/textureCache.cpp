@@ -0,0 +1,222 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "pxr/imaging/hdAi/textureCache.h"
+
+#include <pxr/base/arch/fileSystem.h>
+#include <pxr/base/arch/hash.h>
+#include <pxr/base/arch/systemInfo.h>
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+
+#include "pxr/imaging/hdAi/config.h"
+#include "pxr/imaging/hdAi/renderParam.h"
+
+#include <cstdio>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+
+// Scanline formats worth converting. Tx files are already tiled and
+// mipmapped, and other files might not be images at all.
+bool _IsConvertible(const std::string& path) {
+    // Udim and tile tokens are expanded by Arnold at render time.
+    if (path.find('<') != std::string::npos) { return false; }
+    const auto extension = TfStringToLower(TfGetExtension(path));
+    return extension == "exr" || extension == "tif" || extension == "tiff" ||
+           extension == "png" || extension == "jpg" || extension == "jpeg" ||
+           extension == "tga" || extension == "hdr" || extension == "bmp";
+}
+
+} // namespace
+
+HdAiTextureCache::HdAiTextureCache() {
+    const auto& config = HdAiConfig::GetInstance();
+    if (!config.texture_cache) { return; }
+    auto directory = config.texture_cache_path;
+    if (directory.empty()) {
+        directory = TfStringCatPaths(ArchGetTmpDir(), "hdAiTextureCache");
+    }
+    if (TfIsDir(directory) || TfMakeDirs(directory, -1, true)) {
+        _directory = directory;
+    } else {
+        TF_WARN(
+            "Unable to create the texture cache directory %s.",
+            directory.c_str());
+    }
+}
+
+HdAiTextureCache::~HdAiTextureCache() {
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _stop = true;
+        _queue.clear();
+    }
+    _condition.notify_all();
+    // A running conversion is finished first.
+    if (_worker.joinable()) { _worker.join(); }
+}
+
+std::string HdAiTextureCache::Resolve(
+    const std::string& path, const AtNode* node, const AtString& param) {
+    if (_directory.empty() || !_IsConvertible(path)) { return path; }
+    // Nodes are looked up by name when the conversion finishes, so unnamed
+    // nodes are not updated.
+    const Reference reference{AtString(AiNodeGetName(node)), param};
+    const auto addReference = [&](std::vector<Reference>& references) {
+        if (reference.node.empty()) { return; }
+        for (const auto& existing : references) {
+            if (existing.node == reference.node &&
+                existing.param == reference.param) {
+                return;
+            }
+        }
+        references.push_back(reference);
+    };
+    std::lock_guard<std::mutex> guard(_mutex);
+    const auto it = _resolved.find(path);
+    if (it != _resolved.end()) {
+        const auto pending = _references.find(path);
+        if (pending != _references.end()) { addReference(pending->second); }
+        return it->second;
+    }
+    double mtime = 0.0;
+    if (!ArchGetModificationTime(path.c_str(), &mtime)) {
+        _resolved.emplace(path, path);
+        return path;
+    }
+    // Keyed by the path and the modification time, so edited textures are
+    // converted again.
+    const auto cached = TfStringCatPaths(
+        _directory,
+        TfStringPrintf(
+            "%016llx_%lld.tx",
+            static_cast<unsigned long long>(
+                ArchHash64(path.c_str(), path.size())),
+            static_cast<long long>(mtime * 1000.0)));
+    if (TfIsFile(cached)) {
+        _resolved.emplace(path, cached);
+        return cached;
+    }
+    _resolved.emplace(path, path);
+    addReference(_references[path]);
+    _queue.emplace_back(path, cached);
+    if (!_worker.joinable()) {
+        _worker = std::thread(&HdAiTextureCache::_Run, this);
+    }
+    _condition.notify_one();
+    return path;
+}
+
+void HdAiTextureCache::RenameNode(const AtString& from, const AtString& to) {
+    if (from == to) { return; }
+    std::lock_guard<std::mutex> guard(_mutex);
+    for (auto& pending : _references) {
+        for (auto& reference : pending.second) {
+            if (reference.node == from) { reference.node = to; }
+        }
+    }
+}
+
+void HdAiTextureCache::ApplyFinished(
+    AtUniverse* universe, HdAiRenderParam& param) {
+    std::vector<std::pair<std::string, std::string>> finished;
+    std::vector<std::vector<Reference>> references;
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (_finished.empty()) { return; }
+        finished.swap(_finished);
+        for (const auto& job : finished) {
+            const auto it = _references.find(job.first);
+            if (it == _references.end()) {
+                references.emplace_back();
+            } else {
+                references.push_back(std::move(it->second));
+                _references.erase(it);
+            }
+        }
+    }
+    auto interrupted = false;
+    for (size_t i = 0; i < finished.size(); ++i) {
+        const auto& source = finished[i].first;
+        for (const auto& reference : references[i]) {
+            auto* node = AiNodeLookUpByName(universe, reference.node);
+            if (node == nullptr) { continue; }
+            const auto value = AiNodeGetStr(node, reference.param);
+            if (value.empty() || source != value.c_str()) { continue; }
+            if (!interrupted) {
+                param.Interrupt();
+                interrupted = true;
+            }
+            AiNodeSetStr(node, reference.param, finished[i].second.c_str());
+        }
+    }
+}
+
+bool HdAiTextureCache::HasPendingJobs() const {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return !_queue.empty() || _numRunning != 0 || !_finished.empty();
+}
+
+void HdAiTextureCache::_Run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _condition.wait(lock, [this]() { return _stop || !_queue.empty(); });
+        if (_stop) { return; }
+        const auto job = _queue.front();
+        _queue.pop_front();
+        ++_numRunning;
+        lock.unlock();
+
+        // The file is only moved to its final name once complete, so a
+        // partial file is never picked up by another session. The process id
+        // keeps sessions converting the same texture from sharing the
+        // temporary file.
+        const auto temporary = TfStringPrintf(
+            "%s_%d.tmp.tx", job.second.substr(0, job.second.size() - 3).c_str(),
+            ArchGetProcessId());
+        AiMakeTx(
+            job.first.c_str(),
+            TfStringPrintf(
+                "-o \"%s\" --oiio --opaque-detect --constant-color-detect "
+                "--fixnan box3",
+                temporary.c_str())
+                .c_str());
+        AtMakeTxStatus* statuses = nullptr;
+        const char** sourceFiles = nullptr;
+        unsigned int numSubmitted = 0;
+        AiMakeTxWaitJob(statuses, sourceFiles, numSubmitted);
+        AiFree(statuses);
+        AiFree(sourceFiles);
+        const auto success =
+            TfIsFile(temporary) &&
+            std::rename(temporary.c_str(), job.second.c_str()) == 0;
+        if (!success) {
+            if (TfIsFile(temporary)) { TfDeleteFile(temporary); }
+            TF_WARN("Unable to convert %s to a tx file.", job.first.c_str());
+        }
+
+        lock.lock();
+        --_numRunning;
+        if (success) {
+            _resolved[job.first] = job.second;
+            _finished.push_back(job);
+        } else {
+            _references.erase(job.first);
+        }
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
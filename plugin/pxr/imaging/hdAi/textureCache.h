@@ -0,0 +1,104 @@
+// Copyright 2019 Luma Pictures
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef HDAI_TEXTURE_CACHE_H
+#define HDAI_TEXTURE_CACHE_H
+
+#include <pxr/pxr.h>
+#include "pxr/imaging/hdAi/api.h"
+
+#include <ai.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class HdAiRenderParam;
+
+/// Converts the textures used by the scene to tiled, mipmapped tx files in the
+/// background.
+///
+/// The converted files are stored in a local cache directory, named after the
+/// hash of the source path and its modification time, so they are reused
+/// across sessions and refreshed when the source changes. Until a texture is
+/// converted, the source file is used, and once it's ready the parameters
+/// that resolved the source are switched to the cached file.
+class HdAiTextureCache {
+public:
+    HDAI_API
+    HdAiTextureCache();
+    HDAI_API
+    ~HdAiTextureCache();
+
+    /// Returns the cached tx file of \p path if it's ready. Otherwise the
+    /// conversion is queued, if needed, and \p path is returned. The
+    /// parameter \p param of \p node, set to the returned path, is switched
+    /// to the tx file once converted.
+    HDAI_API
+    std::string Resolve(
+        const std::string& path, const AtNode* node, const AtString& param);
+
+    /// Moves the pending parameters of the node named \p from to \p to, for
+    /// nodes renamed while their conversions are pending.
+    HDAI_API
+    void RenameNode(const AtString& from, const AtString& to);
+
+    /// Switches the parameters that resolved a source file to its converted
+    /// file, for the conversions finished since the last call. The nodes are
+    /// looked up by name in \p universe, and skipped if they were destroyed
+    /// or point to another file since. The render is only interrupted if
+    /// there is a node to update.
+    HDAI_API
+    void ApplyFinished(AtUniverse* universe, HdAiRenderParam& param);
+
+    /// Returns true while conversions are queued, running, or not yet
+    /// applied.
+    HDAI_API
+    bool HasPendingJobs() const;
+
+private:
+    /// Parameter set to a source file while its conversion is pending.
+    struct Reference {
+        AtString node;
+        AtString param;
+    };
+
+    void _Run();
+
+    std::string _directory;
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    /// Source and cached file of the queued conversions.
+    std::deque<std::pair<std::string, std::string>> _queue;
+    /// Files to use for each source path, the source itself while the
+    /// conversion is pending or if it failed.
+    std::unordered_map<std::string, std::string> _resolved;
+    /// Parameters to update for each pending source path.
+    std::unordered_map<std::string, std::vector<Reference>> _references;
+    /// Conversions finished since the last ApplyFinished.
+    std::vector<std::pair<std::string, std::string>> _finished;
+    size_t _numRunning = 0;
+    bool _stop = false;
+    std::thread _worker;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
+
+#endif // HDAI_TEXTURE_CACHE_H
@@ -13,22 +13,55 @@
 // limitations under the License.
 #include "pxr/imaging/hdAi/utils.h"
 
+#include <pxr/base/arch/hash.h>
 #include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/work/loops.h>
 
 #include <pxr/usd/sdf/assetPath.h>
 
+#include "pxr/imaging/hdAi/config.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 TF_DEFINE_PRIVATE_TOKENS(
     _tokens, (BOOL)(BYTE)(INT)(UINT)(FLOAT)(VECTOR2)(VECTOR)(RGB)(RGBA)(STRING)(
-                 constant)(uniform)(varying)(indexed)(
-                 (constantArray, "constant ARRAY")));
+                 constant)(uniform)(varying)(indexed)(velocities)(
+                 accelerations)((constantArray, "constant ARRAY")));
 
 namespace {
 
+namespace Str {
+const AtString motion_start("motion_start");
+const AtString motion_end("motion_end");
+} // namespace Str
+
+// Loops over the elements of large arrays, like particle sets, are split into
+// chunks running in parallel. Smaller arrays are not worth the scheduling.
+template <typename Fn>
+inline void _ParallelForN(size_t n, Fn&& fn) {
+    constexpr size_t minParallel = 1 << 14;
+    if (n < minParallel) {
+        fn(size_t{0}, n);
+    } else {
+        WorkParallelForN(n, std::forward<Fn>(fn));
+    }
+}
+
 inline bool _Declare(
     AtNode* node, const TfToken& name, const TfToken& scope,
     const TfToken& type) {
+    // Declaring an existing user parameter fails, which happens every time
+    // the primvars of a node are synced again.
+    if (AiNodeLookUpUserParameter(node, name.GetText()) != nullptr) {
+        AiNodeResetParameter(node, name.GetText());
+    }
     return AiNodeDeclare(
         node, name.GetText(),
         TfStringPrintf("%s %s", scope.GetText(), type.GetText()).c_str());
@@ -85,6 +118,24 @@ inline uint32_t _DeclareAndAssignFromArray(
     return 0;
 }
 
+template <typename T>
+inline bool _ConvertArray(
+    const VtValue& value, uint8_t arnoldType, AtArray*& arr) {
+    if (!value.IsHolding<VtArray<T>>()) { return false; }
+    const auto& v = value.UncheckedGet<VtArray<T>>();
+    const auto numElements = static_cast<uint32_t>(v.size());
+    arr = AiArrayAllocate(numElements, 1, arnoldType);
+    if (numElements > 0) {
+        auto* out = static_cast<T*>(AiArrayMap(arr));
+        const auto* in = v.cdata();
+        _ParallelForN(numElements, [out, in](size_t begin, size_t end) {
+            std::copy(in + begin, in + end, out + begin);
+        });
+        AiArrayUnmap(arr);
+    }
+    return true;
+}
+
 inline void _DeclareAndAssignConstant(
     AtNode* node, const TfToken& name, const VtValue& value,
     bool isColor = false) {
@@ -135,6 +186,113 @@ inline void _DeclareAndAssignConstant(
     }
 }
 
+template <typename T>
+inline bool _GetElement(const VtValue& value, size_t index, VtValue& element) {
+    if (!value.IsHolding<T>()) { return false; }
+    const auto& v = value.UncheckedGet<T>();
+    if (index < v.size()) { element = VtValue(v[index]); }
+    return true;
+}
+
+// Elements are welded when their bits match, so -0 and 0 are kept apart and
+// NaNs don't break the lookup.
+template <typename T>
+struct _BitwiseHash {
+    size_t operator()(const T& v) const {
+        return static_cast<size_t>(
+            ArchHash64(reinterpret_cast<const char*>(&v), sizeof(T)));
+    }
+};
+
+template <typename T>
+struct _BitwiseEqual {
+    bool operator()(const T& a, const T& b) const {
+        return std::memcmp(&a, &b, sizeof(T)) == 0;
+    }
+};
+
+template <typename T>
+inline bool _Weld(
+    const VtValue& value, uint8_t arnoldType, AtArray*& values,
+    AtArray*& indices) {
+    if (!value.IsHolding<VtArray<T>>()) { return false; }
+    const auto& v = value.UncheckedGet<VtArray<T>>();
+    const auto numElements = static_cast<uint32_t>(v.size());
+    std::unordered_map<T, uint32_t, _BitwiseHash<T>, _BitwiseEqual<T>> lookup;
+    lookup.reserve(numElements);
+    std::vector<T> unique;
+    indices = AiArrayAllocate(numElements, 1, AI_TYPE_UINT);
+    if (numElements > 0) {
+        auto* idxs = static_cast<uint32_t*>(AiArrayMap(indices));
+        for (auto i = decltype(numElements){0}; i < numElements; ++i) {
+            const auto it = lookup.emplace(
+                v[i], static_cast<uint32_t>(unique.size()));
+            if (it.second) { unique.push_back(v[i]); }
+            idxs[i] = it.first->second;
+        }
+        AiArrayUnmap(indices);
+    }
+    values = AiArrayConvert(
+        static_cast<uint32_t>(unique.size()), 1, arnoldType, unique.data());
+    return true;
+}
+
+// Extrapolates the keys from a single sample of the positions, using the
+// velocities and the optional accelerations, so the scene delegate doesn't
+// have to read sub-frame samples.
+AtArray* _SampleVelocityKeys(
+    HdSceneDelegate* delegate, const SdfPath& id, const TfToken& key,
+    size_t numKeys) {
+    const auto velocitiesValue = delegate->Get(id, _tokens->velocities);
+    if (!velocitiesValue.IsHolding<VtVec3fArray>()) { return nullptr; }
+    const auto pointsValue = delegate->Get(id, key);
+    if (!pointsValue.IsHolding<VtVec3fArray>()) { return nullptr; }
+    const auto& points = pointsValue.UncheckedGet<VtVec3fArray>();
+    const auto& velocities = velocitiesValue.UncheckedGet<VtVec3fArray>();
+    const auto numPoints = points.size();
+    if (velocities.size() != numPoints) { return nullptr; }
+    const auto accelerationsValue = delegate->Get(id, _tokens->accelerations);
+    const auto hasAccelerations =
+        accelerationsValue.IsHolding<VtVec3fArray>() &&
+        accelerationsValue.UncheckedGet<VtVec3fArray>().size() == numPoints;
+
+    const auto& config = HdAiConfig::GetInstance();
+    auto* arr = AiArrayAllocate(numPoints, numKeys, AI_TYPE_VECTOR);
+    auto* data = static_cast<float*>(AiArrayMap(arr));
+    // The vectors are processed as flat float arrays, so the loops vectorize.
+    const auto numFloats = numPoints * 3;
+    const auto* p = points.cdata()->data();
+    const auto* v = velocities.cdata()->data();
+    const auto* a =
+        hasAccelerations
+            ? accelerationsValue.UncheckedGet<VtVec3fArray>().cdata()->data()
+            : nullptr;
+    const auto step = (config.shutter_end - config.shutter_start) /
+                      static_cast<float>(numKeys - 1);
+    const auto shutterStart = config.shutter_start;
+    const auto framesPerSecond = config.frames_per_second;
+    _ParallelForN(numFloats, [&](size_t begin, size_t end) {
+        for (auto k = decltype(numKeys){0}; k < numKeys; ++k) {
+            auto* out = data + k * numFloats;
+            // Velocities are in units per second and shutter times in frames.
+            const auto t =
+                (shutterStart + step * static_cast<float>(k)) / framesPerSecond;
+            if (a == nullptr) {
+                for (auto i = begin; i < end; ++i) {
+                    out[i] = p[i] + v[i] * t;
+                }
+            } else {
+                const auto halfT2 = 0.5f * t * t;
+                for (auto i = begin; i < end; ++i) {
+                    out[i] = p[i] + v[i] * t + a[i] * halfT2;
+                }
+            }
+        }
+    });
+    AiArrayUnmap(arr);
+    return arr;
+}
+
 } // namespace
 
 AtMatrix HdAiConvertMatrix(const GfMatrix4d& in) {
@@ -200,8 +358,31 @@ GfMatrix4f HdAiConvertMatrix(const AtMatrix& in) {
     return out;
 }
 
-void HdAiSetTransform(
-    AtNode* node, HdSceneDelegate* delegate, const SdfPath& id) {
+AtArray* HdAiConvertIndices(const VtIntArray& indices) {
+    // Indices are never negative, so the bits of the int and unsigned int
+    // representations match and the data is copied in one go.
+    static_assert(
+        sizeof(int) == sizeof(uint32_t), "Indices have to be 32 bit wide.");
+    const auto numIndices = static_cast<uint32_t>(indices.size());
+    auto* arr = AiArrayAllocate(numIndices, 1, AI_TYPE_UINT);
+    if (numIndices > 0) {
+        std::memcpy(AiArrayMap(arr), indices.cdata(), numIndices * sizeof(int));
+        AiArrayUnmap(arr);
+    }
+    return arr;
+}
+
+AtArray* HdAiGenerateIdentityIndices(uint32_t numElements) {
+    auto* arr = AiArrayAllocate(numElements, 1, AI_TYPE_UINT);
+    if (numElements > 0) {
+        auto* data = static_cast<uint32_t*>(AiArrayMap(arr));
+        std::iota(data, data + numElements, 0u);
+        AiArrayUnmap(arr);
+    }
+    return arr;
+}
+
+AtArray* HdAiSampleTransform(HdSceneDelegate* delegate, const SdfPath& id) {
     // For now this is hardcoded to two samples and 0.0 / 1.0 sample times.
     constexpr size_t maxSamples = 2;
     HdTimeSampleArray<GfMatrix4d, maxSamples> xf;
@@ -210,7 +391,12 @@ void HdAiSetTransform(
     for (auto i = decltype(xf.count){0}; i < xf.count; ++i) {
         AiArraySetMtx(matrices, i, HdAiConvertMatrix(xf.values[i]));
     }
-    AiNodeSetArray(node, "matrix", matrices);
+    return matrices;
+}
+
+void HdAiSetTransform(
+    AtNode* node, HdSceneDelegate* delegate, const SdfPath& id) {
+    AiNodeSetArray(node, "matrix", HdAiSampleTransform(delegate, id));
 }
 
 void HdAiSetTransform(
@@ -234,6 +420,102 @@ void HdAiSetTransform(
     }
 }
 
+AtArray* HdAiSampleDeformationKeys(
+    HdSceneDelegate* delegate, const SdfPath& id, const TfToken& key,
+    HdAiMotionSamples& samples) {
+    const auto& config = HdAiConfig::GetInstance();
+    const auto numKeys = static_cast<size_t>(config.deformation_motion_keys);
+    if (config.velocity_motion_blur && numKeys > 1) {
+        auto* arr = _SampleVelocityKeys(delegate, id, key, numKeys);
+        if (arr != nullptr) { return arr; }
+    }
+    // Authored samples might be denser or sparser than the keys, so we ask
+    // for more than needed and resample.
+    if (samples.times.size() < numKeys * 2) {
+        samples.times.resize(numKeys * 2);
+        samples.values.resize(numKeys * 2);
+    }
+    auto numSamples = delegate->SamplePrimvar(
+        id, key, samples.times.size(), samples.times.data(),
+        samples.values.data());
+    if (numSamples > samples.times.size()) {
+        samples.times.resize(numSamples);
+        samples.values.resize(numSamples);
+        numSamples = delegate->SamplePrimvar(
+            id, key, numSamples, samples.times.data(), samples.values.data());
+    }
+    if (numSamples == 0 ||
+        ARCH_UNLIKELY(!samples.values[0].IsHolding<VtVec3fArray>())) {
+        return nullptr;
+    }
+    // Samples with a different topology are ignored.
+    const auto numPoints =
+        samples.values[0].UncheckedGet<VtVec3fArray>().size();
+    size_t numValidSamples = 1;
+    for (auto i = decltype(numSamples){1}; i < numSamples; ++i) {
+        if (!samples.values[i].IsHolding<VtVec3fArray>() ||
+            samples.values[i].UncheckedGet<VtVec3fArray>().size() !=
+                numPoints) {
+            continue;
+        }
+        if (i != numValidSamples) {
+            samples.times[numValidSamples] = samples.times[i];
+            samples.values[numValidSamples].Swap(samples.values[i]);
+        }
+        ++numValidSamples;
+    }
+    numSamples = numValidSamples;
+
+    // A single sample can't describe motion.
+    const auto keys = numSamples > 1 ? numKeys : 1;
+    auto* arr = AiArrayAllocate(numPoints, keys, AI_TYPE_VECTOR);
+    auto* data = static_cast<GfVec3f*>(AiArrayMap(arr));
+    const auto shutterStart = config.shutter_start;
+    const auto shutterEnd = config.shutter_end;
+    const auto step =
+        keys > 1 ? (shutterEnd - shutterStart) / static_cast<float>(keys - 1)
+                 : 0.0f;
+    for (auto k = decltype(keys){0}; k < keys; ++k) {
+        auto* out = data + k * numPoints;
+        const auto time =
+            keys > 1 ? shutterStart + step * static_cast<float>(k) : 0.0f;
+        // Samples are sorted by time, the keys outside the sampled range
+        // take the closest sample.
+        size_t next = 0;
+        while (next < numSamples && samples.times[next] < time) { ++next; }
+        if (next == 0 || next == numSamples) {
+            const auto* v = samples.values[next == 0 ? 0 : numSamples - 1]
+                                .UncheckedGet<VtVec3fArray>()
+                                .cdata();
+            _ParallelForN(numPoints, [out, v](size_t begin, size_t end) {
+                std::copy(v + begin, v + end, out + begin);
+            });
+            continue;
+        }
+        const auto* v0 =
+            samples.values[next - 1].UncheckedGet<VtVec3fArray>().cdata();
+        const auto* v1 =
+            samples.values[next].UncheckedGet<VtVec3fArray>().cdata();
+        const auto t = (time - samples.times[next - 1]) /
+                       (samples.times[next] - samples.times[next - 1]);
+        _ParallelForN(numPoints, [out, v0, v1, t](size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i) {
+                out[i] = v0[i] + (v1[i] - v0[i]) * t;
+            }
+        });
+    }
+    AiArrayUnmap(arr);
+    // The values hold references to the scene delegate's arrays.
+    for (auto& value : samples.values) { value = VtValue(); }
+    return arr;
+}
+
+void HdAiSetMotionRange(AtNode* node) {
+    const auto& config = HdAiConfig::GetInstance();
+    AiNodeSetFlt(node, Str::motion_start, config.shutter_start);
+    AiNodeSetFlt(node, Str::motion_end, config.shutter_end);
+}
+
 void HdAiSetParameter(
     AtNode* node, const AtParamEntry* pentry, const VtValue& value) {
     const auto paramName = AiParamGetName(pentry);
@@ -322,65 +604,140 @@ void HdAiSetParameter(
 }
 
 void HdAiSetConstantPrimvar(
-    AtNode* node, const SdfPath& id, HdSceneDelegate* delegate,
-    const HdPrimvarDescriptor& primvarDesc) {
-    const auto isColor = primvarDesc.role == HdPrimvarRoleTokens->color;
-    if (primvarDesc.name == HdPrimvarRoleTokens->color && isColor) {
-        if (!_Declare(
-                node, primvarDesc.name, _tokens->constant, _tokens->RGBA)) {
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value) {
+    const auto isColor = role == HdPrimvarRoleTokens->color;
+    if (name == HdPrimvarRoleTokens->color && isColor) {
+        if (!_Declare(node, name, _tokens->constant, _tokens->RGBA)) {
             return;
         }
-        const auto value = delegate->Get(id, primvarDesc.name);
         if (value.IsHolding<GfVec4f>()) {
             const auto& v = value.UncheckedGet<GfVec4f>();
-            AiNodeSetRGBA(
-                node, primvarDesc.name.GetText(), v[0], v[1], v[2], v[3]);
+            AiNodeSetRGBA(node, name.GetText(), v[0], v[1], v[2], v[3]);
         } else if (value.IsHolding<VtVec4fArray>()) {
             const auto& arr = value.UncheckedGet<VtVec4fArray>();
             if (arr.empty()) { return; }
             const auto& v = arr[0];
-            AiNodeSetRGBA(
-                node, primvarDesc.name.GetText(), v[0], v[1], v[2], v[3]);
+            AiNodeSetRGBA(node, name.GetText(), v[0], v[1], v[2], v[3]);
         }
+        // Declaring it again would replace the RGBA parameter.
+        return;
     }
-    _DeclareAndAssignConstant(
-        node, primvarDesc.name, delegate->Get(id, primvarDesc.name), isColor);
+    _DeclareAndAssignConstant(node, name, value, isColor);
 }
 
 void HdAiSetUniformPrimvar(
-    AtNode* node, const SdfPath& id, HdSceneDelegate* delegate,
-    const HdPrimvarDescriptor& primvarDesc) {
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value) {
     _DeclareAndAssignFromArray(
-        node, primvarDesc.name, _tokens->uniform,
-        delegate->Get(id, primvarDesc.name),
-        primvarDesc.role == HdPrimvarRoleTokens->color);
+        node, name, _tokens->uniform, value,
+        role == HdPrimvarRoleTokens->color);
 }
 
 void HdAiSetVertexPrimvar(
-    AtNode* node, const SdfPath& id, HdSceneDelegate* delegate,
-    const HdPrimvarDescriptor& primvarDesc) {
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value) {
     _DeclareAndAssignFromArray(
-        node, primvarDesc.name, _tokens->varying,
-        delegate->Get(id, primvarDesc.name),
-        primvarDesc.role == HdPrimvarRoleTokens->color);
+        node, name, _tokens->varying, value,
+        role == HdPrimvarRoleTokens->color);
+}
+
+AtArray* HdAiConvertPrimvarArray(
+    const VtValue& value, bool isColor, TfToken& type) {
+    AtArray* arr = nullptr;
+    if (_ConvertArray<bool>(value, AI_TYPE_BOOLEAN, arr)) {
+        type = _tokens->BOOL;
+    } else if (_ConvertArray<unsigned char>(value, AI_TYPE_BYTE, arr)) {
+        type = _tokens->BYTE;
+    } else if (_ConvertArray<unsigned int>(value, AI_TYPE_UINT, arr)) {
+        type = _tokens->UINT;
+    } else if (_ConvertArray<int>(value, AI_TYPE_INT, arr)) {
+        type = _tokens->INT;
+    } else if (_ConvertArray<float>(value, AI_TYPE_FLOAT, arr)) {
+        type = _tokens->FLOAT;
+    } else if (_ConvertArray<GfVec2f>(value, AI_TYPE_VECTOR2, arr)) {
+        type = _tokens->VECTOR2;
+    } else if (_ConvertArray<GfVec3f>(
+                   value, isColor ? AI_TYPE_RGB : AI_TYPE_VECTOR, arr)) {
+        type = isColor ? _tokens->RGB : _tokens->VECTOR;
+    } else if (_ConvertArray<GfVec4f>(value, AI_TYPE_RGBA, arr)) {
+        type = _tokens->RGBA;
+    }
+    return arr;
+}
+
+void HdAiSetVaryingPrimvar(
+    AtNode* node, const TfToken& name, const TfToken& type, AtArray* values) {
+    if (!_Declare(node, name, _tokens->varying, type)) {
+        AiArrayDestroy(values);
+        return;
+    }
+    AiNodeSetArray(node, name.GetText(), values);
+}
+
+bool HdAiWeldFaceVarying(
+    const VtValue& value, bool isColor, TfToken& type, AtArray*& values,
+    AtArray*& indices) {
+    if (_Weld<float>(value, AI_TYPE_FLOAT, values, indices)) {
+        type = _tokens->FLOAT;
+    } else if (_Weld<GfVec2f>(value, AI_TYPE_VECTOR2, values, indices)) {
+        type = _tokens->VECTOR2;
+    } else if (_Weld<GfVec3f>(
+                   value, isColor ? AI_TYPE_RGB : AI_TYPE_VECTOR, values,
+                   indices)) {
+        type = isColor ? _tokens->RGB : _tokens->VECTOR;
+    } else if (_Weld<GfVec4f>(value, AI_TYPE_RGBA, values, indices)) {
+        type = _tokens->RGBA;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void HdAiSetIndexedPrimvar(
+    AtNode* node, const TfToken& name, const TfToken& type, AtArray* values,
+    AtArray* indices) {
+    if (!_Declare(node, name, _tokens->indexed, type)) {
+        AiArrayDestroy(values);
+        AiArrayDestroy(indices);
+        return;
+    }
+    AiNodeSetArray(node, name.GetText(), values);
+    AiNodeSetArray(
+        node, TfStringPrintf("%sidxs", name.GetText()).c_str(), indices);
 }
 
 void HdAiSetFaceVaryingPrimvar(
-    AtNode* node, const SdfPath& id, HdSceneDelegate* delegate,
-    const HdPrimvarDescriptor& primvarDesc) {
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value) {
     const auto numElements = _DeclareAndAssignFromArray(
-        node, primvarDesc.name, _tokens->indexed,
-        delegate->Get(id, primvarDesc.name),
-        primvarDesc.role == HdPrimvarRoleTokens->color);
+        node, name, _tokens->indexed, value,
+        role == HdPrimvarRoleTokens->color);
     if (numElements != 0) {
-        auto* a = AiArrayAllocate(numElements, 1, AI_TYPE_UINT);
-        for (auto i = decltype(numElements){0}; i < numElements; ++i) {
-            AiArraySetUInt(a, i, i);
-        }
         AiNodeSetArray(
-            node, TfStringPrintf("%sidxs", primvarDesc.name.GetText()).c_str(),
-            a);
+            node, TfStringPrintf("%sidxs", name.GetText()).c_str(),
+            HdAiGenerateIdentityIndices(numElements));
     }
 }
 
+void HdAiSetInstancePrimvar(
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value, size_t index) {
+    VtValue element;
+    if (!_GetElement<VtBoolArray>(value, index, element) &&
+        !_GetElement<VtUCharArray>(value, index, element) &&
+        !_GetElement<VtUIntArray>(value, index, element) &&
+        !_GetElement<VtIntArray>(value, index, element) &&
+        !_GetElement<VtFloatArray>(value, index, element) &&
+        !_GetElement<VtDoubleArray>(value, index, element) &&
+        !_GetElement<VtVec2fArray>(value, index, element) &&
+        !_GetElement<VtVec3fArray>(value, index, element) &&
+        !_GetElement<VtVec4fArray>(value, index, element)) {
+        return;
+    }
+    if (element.IsEmpty()) { return; }
+    _DeclareAndAssignConstant(
+        node, name, element, role == HdPrimvarRoleTokens->color);
+}
+
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -30,6 +30,13 @@
 
 PXR_NAMESPACE_OPEN_SCOPE
 
+/// Scratch buffers for sampling the deformation of a shape, reused between
+/// syncs of the same prim.
+struct HdAiMotionSamples {
+    std::vector<float> times;
+    std::vector<VtValue> values;
+};
+
 HDAI_API
 AtMatrix HdAiConvertMatrix(const GfMatrix4d& in);
 HDAI_API
@@ -37,30 +44,84 @@ AtMatrix HdAiConvertMatrix(const GfMatrix4f& in);
 HDAI_API
 GfMatrix4f HdAiConvertMatrix(const AtMatrix& in);
 HDAI_API
+AtArray* HdAiConvertIndices(const VtIntArray& indices);
+HDAI_API
+AtArray* HdAiGenerateIdentityIndices(uint32_t numElements);
+HDAI_API
+AtArray* HdAiSampleTransform(HdSceneDelegate* delegate, const SdfPath& id);
+HDAI_API
 void HdAiSetTransform(
     AtNode* node, HdSceneDelegate* delegate, const SdfPath& id);
 HDAI_API
 void HdAiSetTransform(
     std::vector<AtNode*>& nodes, HdSceneDelegate* delegate, const SdfPath& id);
+/// Samples the \p key primvar of \p id, and returns an array with HdAiConfig's
+/// deformation_motion_keys keys, evenly spaced over the shutter interval.
+/// Returns nullptr if the primvar is not holding a VtVec3fArray. Doesn't touch
+/// any node, so it's safe to call from multiple threads.
+HDAI_API
+AtArray* HdAiSampleDeformationKeys(
+    HdSceneDelegate* delegate, const SdfPath& id, const TfToken& key,
+    HdAiMotionSamples& samples);
+/// Sets the motion range of \p node to the shutter interval the deformation
+/// keys are sampled over.
+HDAI_API
+void HdAiSetMotionRange(AtNode* node);
 HDAI_API
 void HdAiSetParameter(
     AtNode* node, const AtParamEntry* pentry, const VtValue& value);
 HDAI_API
 void HdAiSetConstantPrimvar(
-    AtNode* node, const SdfPath& id, HdSceneDelegate* delegate,
-    const HdPrimvarDescriptor& primvarDesc);
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value);
 HDAI_API
 void HdAiSetUniformPrimvar(
-    AtNode* node, const SdfPath& id, HdSceneDelegate* delegate,
-    const HdPrimvarDescriptor& primvarDesc);
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value);
 HDAI_API
 void HdAiSetVertexPrimvar(
-    AtNode* node, const SdfPath& id, HdSceneDelegate* delegate,
-    const HdPrimvarDescriptor& primvarDesc);
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value);
+/// Converts the array \p value to an Arnold array, and returns the Arnold
+/// type name of its elements in \p type. Returns nullptr if the type of
+/// \p value is not supported. Large arrays are copied in parallel chunks.
+/// Doesn't touch any node, so it's safe to call from multiple threads.
+HDAI_API
+AtArray* HdAiConvertPrimvarArray(
+    const VtValue& value, bool isColor, TfToken& type);
+/// Declares the varying user data \p name on \p node and sets its
+/// \p values, converted by HdAiConvertPrimvarArray.
+HDAI_API
+void HdAiSetVaryingPrimvar(
+    AtNode* node, const TfToken& name, const TfToken& type, AtArray* values);
+/// Welds the bitwise identical elements of the face-varying \p value, so the
+/// data is stored in an indexed form instead of flattened. The unique
+/// elements are returned in \p values, the index of each face-vertex in
+/// \p indices and the Arnold type name in \p type. Returns false if the type
+/// of \p value is not supported. Doesn't touch any node. Welding hashes every
+/// element, so it's only worth it for data that doesn't change often.
+HDAI_API
+bool HdAiWeldFaceVarying(
+    const VtValue& value, bool isColor, TfToken& type, AtArray*& values,
+    AtArray*& indices);
+/// Declares the indexed user data \p name on \p node and sets its \p values
+/// and \p indices.
+HDAI_API
+void HdAiSetIndexedPrimvar(
+    AtNode* node, const TfToken& name, const TfToken& type, AtArray* values,
+    AtArray* indices);
+/// Declares the indexed user data \p name on \p node, with the flattened
+/// \p value and identity indices.
 HDAI_API
 void HdAiSetFaceVaryingPrimvar(
-    AtNode* node, const SdfPath& id, HdSceneDelegate* delegate,
-    const HdPrimvarDescriptor& primvarDesc);
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value);
+/// Sets the element \p index of the instance rate primvar \p value as
+/// constant user data on \p node.
+HDAI_API
+void HdAiSetInstancePrimvar(
+    AtNode* node, const TfToken& name, const TfToken& role,
+    const VtValue& value, size_t index);
 
 PXR_NAMESPACE_CLOSE_SCOPE
 
@@ -39,7 +39,9 @@ HdAiVolume::HdAiVolume(
     : HdVolume(id, instancerId), _delegate(delegate) {}
 
 HdAiVolume::~HdAiVolume() {
+    _delegate->GetMaterialBindings().Unbind(GetId());
     for (auto& volume : _volumes) { AiNodeDestroy(volume); }
+    _delegate->GetStats().NodeDestroyed(_volumes.size());
 }
 
 void HdAiVolume::Sync(
@@ -47,32 +49,38 @@ void HdAiVolume::Sync(
     HdDirtyBits* dirtyBits, const TfToken& reprToken) {
     TF_UNUSED(reprToken);
     auto* param = reinterpret_cast<HdAiRenderParam*>(renderParam);
+    HdAiRenderStats::SyncTimer timer(
+        param->GetStats(), HdPrimTypeTokens->volume);
+
+    // Volumes look up the openvdb assets and create their nodes while
+    // syncing, so the whole translation is staged.
+    const auto bits = *dirtyBits;
+    param->Stage([this, delegate, bits]() {
+        const auto& id = GetId();
+        auto volumesChanged = false;
+        if (HdChangeTracker::IsTopologyDirty(bits, id)) {
+            _CreateVolumes(id, delegate);
+            volumesChanged = true;
+        }
 
-    const auto& id = GetId();
-    auto volumesChanged = false;
-    if (HdChangeTracker::IsTopologyDirty(*dirtyBits, id)) {
-        param->End();
-        _CreateVolumes(id, delegate);
-        volumesChanged = true;
-    }
-
-    if (volumesChanged || (*dirtyBits & HdChangeTracker::DirtyMaterialId)) {
-        param->End();
-        const auto* material = reinterpret_cast<const HdAiMaterial*>(
-            delegate->GetRenderIndex().GetSprim(
-                HdPrimTypeTokens->material, delegate->GetMaterialId(id)));
-        if (material != nullptr) {
-            auto* surfaceShader = material->GetSurfaceShader();
-            for (auto& volume : _volumes) {
-                AiNodeSetPtr(volume, Str::shader, surfaceShader);
+        if (volumesChanged || (bits & HdChangeTracker::DirtyMaterialId)) {
+            const auto materialId = delegate->GetMaterialId(id);
+            _delegate->GetMaterialBindings().Bind(id, materialId);
+            const auto* material = reinterpret_cast<const HdAiMaterial*>(
+                delegate->GetRenderIndex().GetSprim(
+                    HdPrimTypeTokens->material, materialId));
+            if (material != nullptr) {
+                auto* surfaceShader = material->GetSurfaceShader();
+                for (auto& volume : _volumes) {
+                    AiNodeSetPtr(volume, Str::shader, surfaceShader);
+                }
             }
         }
-    }
 
-    if (HdChangeTracker::IsTransformDirty(*dirtyBits, id)) {
-        param->End();
-        HdAiSetTransform(_volumes, delegate, GetId());
-    }
+        if (HdChangeTracker::IsTransformDirty(bits, id)) {
+            HdAiSetTransform(_volumes, delegate, id);
+        }
+    });
 
     *dirtyBits = HdChangeTracker::Clean;
 }
@@ -102,11 +110,12 @@ void HdAiVolume::_CreateVolumes(const SdfPath& id, HdSceneDelegate* delegate) {
     _volumes.erase(
         std::remove_if(
             _volumes.begin(), _volumes.end(),
-            [&openvdbs](AtNode* node) -> bool {
+            [&](AtNode* node) -> bool {
                 if (openvdbs.find(std::string(
                         AiNodeGetStr(node, Str::filename).c_str())) ==
                     openvdbs.end()) {
                     AiNodeDestroy(node);
+                    _delegate->GetStats().NodeDestroyed();
                     return true;
                 }
                 return false;
@@ -123,6 +132,7 @@ void HdAiVolume::_CreateVolumes(const SdfPath& id, HdSceneDelegate* delegate) {
         }
         if (volume == nullptr) {
             volume = AiNode(_delegate->GetUniverse(), Str::volume);
+            _delegate->GetStats().NodeCreated();
             AiNodeSetStr(volume, Str::filename, openvdb.first.c_str());
             AiNodeSetStr(
                 volume, Str::name,